@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2019 Minyoung.Go <hedone21@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __BENCH_BENCH_H__
+#define __BENCH_BENCH_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Passed from the driver to the client it launches through the compositor */
+#define SPIDER_BENCH_FD			"SPIDER_BENCH_FD"
+#define SPIDER_BENCH_COMPOSITOR_PID	"SPIDER_BENCH_COMPOSITOR_PID"
+/* Last line of a report, so the driver knows it is complete */
+#define SPIDER_BENCH_END		"END\n"
+
+#define BENCH_WARMUP_SEC		1
+
+struct bench_options {
+	const char *compositor;
+	int outputs;
+	int shm_clients;
+	int egl_clients;
+	/* Commits per second of every client, or 0 to follow frame callbacks */
+	int rate;
+	int width, height;
+	int duration;
+	/* wl_shm clients draw RGB565 instead of XRGB8888 */
+	bool rgb565;
+	/* Passed on to the compositor's -o and -R, or NULL */
+	const char *output_config;
+	const char *renderer;
+};
+
+struct bench_samples {
+	int *values;
+	size_t len, cap;
+};
+
+void bench_samples_add(struct bench_samples *samples, int value);
+int bench_samples_percentile(struct bench_samples *samples, int percentile);
+void bench_samples_finish(struct bench_samples *samples);
+
+int bench_client_run(struct bench_options *options);
+
+#endif
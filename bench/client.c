@@ -0,0 +1,784 @@
+/*
+ * Copyright (c) 2019 Minyoung.Go <hedone21@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-client.h>
+#include <wayland-egl.h>
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#include "bench/bench.h"
+#include "common/log.h"
+#include "protocol/presentation-time-client-protocol.h"
+#include "protocol/xdg-shell-client-protocol.h"
+
+#define BENCH_SHM_BUFFERS	3
+
+struct bench_output {
+	struct wl_list link;
+	struct wl_output *wl_output;
+	struct timespec last_present;
+	int frames;
+};
+
+struct bench_buffer {
+	struct wl_buffer *wl_buffer;
+	void *data;
+	bool busy;
+};
+
+struct bench_window {
+	struct wl_list link;
+	struct bench_client *client;
+	bool egl;
+
+	struct wl_surface *surface;
+	struct xdg_surface *xdg_surface;
+	struct xdg_toplevel *toplevel;
+	bool configured;
+
+	struct bench_buffer buffers[BENCH_SHM_BUFFERS];
+	void *shm_data;
+	size_t shm_size;
+
+	struct wl_egl_window *egl_window;
+	EGLSurface egl_surface;
+
+	struct wl_callback *frame_callback;
+	uint32_t frame;
+	struct timespec last_present;
+};
+
+struct bench_feedback {
+	struct bench_window *window;
+	struct bench_output *output;
+	struct timespec committed;
+};
+
+struct bench_client {
+	struct bench_options *options;
+
+	struct wl_display *display;
+	struct wl_registry *registry;
+	struct wl_compositor *compositor;
+	struct wl_shm *shm;
+	struct xdg_wm_base *wm_base;
+	struct wp_presentation *presentation;
+	clockid_t clock_id;
+	struct wl_list outputs;
+	struct wl_list windows;
+
+	EGLDisplay egl_display;
+	EGLConfig egl_config;
+	EGLContext egl_context;
+
+	pid_t compositor_pid;
+	long cpu_ticks;
+	struct timespec start, end;
+	bool started, measuring, done;
+
+	struct bench_samples frame_times;
+	struct bench_samples latencies;
+	int committed, presented, discarded, missed, stalled;
+};
+
+static int timespec_to_usec(const struct timespec *a, const struct timespec *b)
+{
+	return (b->tv_sec - a->tv_sec) * 1000000 + (b->tv_nsec - a->tv_nsec) / 1000;
+}
+
+/* User and system time of a process, in clock ticks */
+static long read_cpu_ticks(pid_t pid)
+{
+	char path[64], buf[1024];
+	snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+
+	FILE *f = fopen(path, "r");
+	if (f == NULL) {
+		return -1;
+	}
+	char *line = fgets(buf, sizeof(buf), f);
+	fclose(f);
+	if (line == NULL) {
+		return -1;
+	}
+
+	/* The command name may contain spaces, so start after it */
+	char *p = strrchr(buf, ')');
+	unsigned long utime, stime;
+	if (p == NULL || sscanf(p + 2,
+			"%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+			&utime, &stime) != 2) {
+		return -1;
+	}
+
+	return utime + stime;
+}
+
+static void window_draw(struct bench_window *window);
+
+static void buffer_handle_release(void *data, struct wl_buffer *wl_buffer)
+{
+	struct bench_buffer *buffer = data;
+
+	buffer->busy = false;
+}
+
+static const struct wl_buffer_listener buffer_listener = {
+	.release = buffer_handle_release,
+};
+
+static int create_shm_file(size_t size)
+{
+	const char *dir = getenv("XDG_RUNTIME_DIR");
+	char path[256];
+
+	snprintf(path, sizeof(path), "%s/spider-bench-shm-XXXXXX", dir ? dir : "/tmp");
+	int fd = mkstemp(path);
+	if (fd < 0) {
+		return -1;
+	}
+	unlink(path);
+
+	if (ftruncate(fd, size) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static int window_init_shm(struct bench_window *window)
+{
+	struct bench_options *options = window->client->options;
+	int stride = options->width * (options->rgb565 ? 2 : 4);
+	size_t size = (size_t)stride * options->height;
+
+	window->shm_size = size * BENCH_SHM_BUFFERS;
+	int fd = create_shm_file(window->shm_size);
+	if (fd < 0) {
+		spider_err("Failed to create shm file\n");
+		return -1;
+	}
+
+	window->shm_data = mmap(NULL, window->shm_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0);
+	if (window->shm_data == MAP_FAILED) {
+		spider_err("Failed to map shm file\n");
+		close(fd);
+		return -1;
+	}
+
+	struct wl_shm_pool *pool = wl_shm_create_pool(window->client->shm, fd,
+			window->shm_size);
+	for (int i = 0; i < BENCH_SHM_BUFFERS; i++) {
+		struct bench_buffer *buffer = &window->buffers[i];
+
+		buffer->data = (char *)window->shm_data + size * i;
+		buffer->wl_buffer = wl_shm_pool_create_buffer(pool, size * i,
+				options->width, options->height, stride,
+				options->rgb565 ? WL_SHM_FORMAT_RGB565 :
+				WL_SHM_FORMAT_XRGB8888);
+		wl_buffer_add_listener(buffer->wl_buffer, &buffer_listener, buffer);
+	}
+	wl_shm_pool_destroy(pool);
+	close(fd);
+
+	return 0;
+}
+
+static int window_init_egl(struct bench_window *window)
+{
+	struct bench_client *client = window->client;
+	struct bench_options *options = client->options;
+
+	window->egl_window = wl_egl_window_create(window->surface,
+			options->width, options->height);
+	window->egl_surface = eglCreateWindowSurface(client->egl_display,
+			client->egl_config, (EGLNativeWindowType)window->egl_window, NULL);
+	if (window->egl_surface == EGL_NO_SURFACE) {
+		spider_err("Failed to create EGL surface\n");
+		return -1;
+	}
+
+	/* Frame pacing is done here, not inside eglSwapBuffers */
+	eglMakeCurrent(client->egl_display, window->egl_surface,
+			window->egl_surface, client->egl_context);
+	eglSwapInterval(client->egl_display, 0);
+
+	return 0;
+}
+
+static void feedback_handle_sync_output(void *data,
+		struct wp_presentation_feedback *wp_feedback, struct wl_output *wl_output)
+{
+	struct bench_feedback *feedback = data;
+	struct bench_output *output;
+
+	wl_list_for_each(output, &feedback->window->client->outputs, link) {
+		if (output->wl_output == wl_output) {
+			feedback->output = output;
+		}
+	}
+}
+
+static void feedback_handle_presented(void *data,
+		struct wp_presentation_feedback *wp_feedback, uint32_t tv_sec_hi,
+		uint32_t tv_sec_lo, uint32_t tv_nsec, uint32_t refresh,
+		uint32_t seq_hi, uint32_t seq_lo, uint32_t flags)
+{
+	struct bench_feedback *feedback = data;
+	struct bench_window *window = feedback->window;
+	struct bench_client *client = window->client;
+	struct bench_output *output = feedback->output;
+
+	struct timespec when = {
+		.tv_sec = ((uint64_t)tv_sec_hi << 32) | tv_sec_lo,
+		.tv_nsec = tv_nsec,
+	};
+
+	if (client->measuring) {
+		client->presented++;
+		bench_samples_add(&client->latencies,
+				timespec_to_usec(&feedback->committed, &when));
+
+		if (window->last_present.tv_sec != 0) {
+			int interval = timespec_to_usec(&window->last_present, &when);
+			bench_samples_add(&client->frame_times, interval);
+
+			/* Only clients that follow frame callbacks are expected to
+			 * make every refresh. */
+			int refresh_usec = refresh / 1000;
+			if (client->options->rate == 0 && refresh_usec > 0 &&
+					interval > refresh_usec * 3 / 2) {
+				client->missed += (interval + refresh_usec / 2) /
+					refresh_usec - 1;
+			}
+		}
+
+		/* Several windows can be presented by the same output frame */
+		if (output != NULL && (output->last_present.tv_sec != when.tv_sec ||
+				output->last_present.tv_nsec != when.tv_nsec)) {
+			output->frames++;
+		}
+	}
+
+	if (output != NULL) {
+		output->last_present = when;
+	}
+	window->last_present = when;
+
+	wp_presentation_feedback_destroy(wp_feedback);
+	free(feedback);
+}
+
+static void feedback_handle_discarded(void *data,
+		struct wp_presentation_feedback *wp_feedback)
+{
+	struct bench_feedback *feedback = data;
+	struct bench_client *client = feedback->window->client;
+
+	if (client->measuring) {
+		client->discarded++;
+	}
+
+	wp_presentation_feedback_destroy(wp_feedback);
+	free(feedback);
+}
+
+static const struct wp_presentation_feedback_listener feedback_listener = {
+	.sync_output = feedback_handle_sync_output,
+	.presented = feedback_handle_presented,
+	.discarded = feedback_handle_discarded,
+};
+
+static void frame_handle_done(void *data, struct wl_callback *callback,
+		uint32_t time)
+{
+	struct bench_window *window = data;
+
+	wl_callback_destroy(callback);
+	window->frame_callback = NULL;
+	window_draw(window);
+}
+
+static const struct wl_callback_listener frame_listener = {
+	.done = frame_handle_done,
+};
+
+static struct bench_buffer *window_next_buffer(struct bench_window *window)
+{
+	for (int i = 0; i < BENCH_SHM_BUFFERS; i++) {
+		if (!window->buffers[i].busy) {
+			return &window->buffers[i];
+		}
+	}
+
+	return NULL;
+}
+
+static void window_draw(struct bench_window *window)
+{
+	struct bench_client *client = window->client;
+	struct bench_options *options = client->options;
+	struct bench_buffer *buffer = NULL;
+
+	if (!window->configured || window->frame_callback != NULL) {
+		return;
+	}
+
+	if (!window->egl) {
+		buffer = window_next_buffer(window);
+		if (buffer == NULL) {
+			/* The compositor still holds every buffer */
+			if (client->measuring) {
+				client->stalled++;
+			}
+			return;
+		}
+	}
+
+	if (options->rate == 0) {
+		window->frame_callback = wl_surface_frame(window->surface);
+		wl_callback_add_listener(window->frame_callback, &frame_listener, window);
+	}
+
+	if (client->presentation != NULL) {
+		struct bench_feedback *feedback = calloc(1, sizeof(*feedback));
+		if (feedback != NULL) {
+			feedback->window = window;
+			clock_gettime(client->clock_id, &feedback->committed);
+			struct wp_presentation_feedback *wp_feedback =
+				wp_presentation_feedback(client->presentation,
+						window->surface);
+			wp_presentation_feedback_add_listener(wp_feedback,
+					&feedback_listener, feedback);
+		}
+	}
+
+	/* A different color every frame, so every frame is fully damaged */
+	float shade = (window->frame % 256) / 255.0;
+	if (window->egl) {
+		eglMakeCurrent(client->egl_display, window->egl_surface,
+				window->egl_surface, client->egl_context);
+		glViewport(0, 0, options->width, options->height);
+		glClearColor(shade, 1.0 - shade, 0.5, 1.0);
+		glClear(GL_COLOR_BUFFER_BIT);
+		eglSwapBuffers(client->egl_display, window->egl_surface);
+	}else {
+		uint32_t color = 0xff000000 | (window->frame % 256) << 16 |
+			(255 - window->frame % 256) << 8 | 0x80;
+		size_t npixels = (size_t)options->width * options->height;
+		if (options->rgb565) {
+			uint16_t *data = buffer->data;
+			uint16_t color565 = (color >> 8 & 0xf800) |
+				(color >> 5 & 0x07e0) | (color >> 3 & 0x001f);
+			for (size_t i = 0; i < npixels; i++) {
+				data[i] = color565;
+			}
+		}else {
+			uint32_t *data = buffer->data;
+			for (size_t i = 0; i < npixels; i++) {
+				data[i] = color;
+			}
+		}
+
+		wl_surface_attach(window->surface, buffer->wl_buffer, 0, 0);
+		wl_surface_damage_buffer(window->surface, 0, 0,
+				options->width, options->height);
+		wl_surface_commit(window->surface);
+		buffer->busy = true;
+	}
+
+	window->frame++;
+	if (client->measuring) {
+		client->committed++;
+	}
+}
+
+static void xdg_surface_handle_configure(void *data,
+		struct xdg_surface *xdg_surface, uint32_t serial)
+{
+	struct bench_window *window = data;
+
+	xdg_surface_ack_configure(xdg_surface, serial);
+	if (!window->configured) {
+		window->configured = true;
+		window_draw(window);
+	}
+}
+
+static const struct xdg_surface_listener xdg_surface_listener = {
+	.configure = xdg_surface_handle_configure,
+};
+
+static void toplevel_handle_configure(void *data,
+		struct xdg_toplevel *toplevel, int32_t width, int32_t height,
+		struct wl_array *states)
+{
+	/* Keep the benchmark size whatever the compositor suggests */
+}
+
+static void toplevel_handle_close(void *data, struct xdg_toplevel *toplevel)
+{
+}
+
+static const struct xdg_toplevel_listener toplevel_listener = {
+	.configure = toplevel_handle_configure,
+	.close = toplevel_handle_close,
+};
+
+static struct bench_window *window_create(struct bench_client *client, bool egl)
+{
+	struct bench_window *window = calloc(1, sizeof(*window));
+	if (window == NULL) {
+		spider_err("Allocation Failed\n");
+		return NULL;
+	}
+	window->client = client;
+	window->egl = egl;
+
+	window->surface = wl_compositor_create_surface(client->compositor);
+	window->xdg_surface = xdg_wm_base_get_xdg_surface(client->wm_base,
+			window->surface);
+	xdg_surface_add_listener(window->xdg_surface, &xdg_surface_listener, window);
+	window->toplevel = xdg_surface_get_toplevel(window->xdg_surface);
+	xdg_toplevel_add_listener(window->toplevel, &toplevel_listener, window);
+	xdg_toplevel_set_title(window->toplevel, egl ? "spider-bench egl" : "spider-bench shm");
+
+	int ret = egl ? window_init_egl(window) : window_init_shm(window);
+	if (ret != 0) {
+		free(window);
+		return NULL;
+	}
+
+	wl_surface_commit(window->surface);
+	wl_list_insert(client->windows.prev, &window->link);
+	return window;
+}
+
+static void wm_base_handle_ping(void *data, struct xdg_wm_base *wm_base,
+		uint32_t serial)
+{
+	xdg_wm_base_pong(wm_base, serial);
+}
+
+static const struct xdg_wm_base_listener wm_base_listener = {
+	.ping = wm_base_handle_ping,
+};
+
+static void presentation_handle_clock_id(void *data,
+		struct wp_presentation *presentation, uint32_t clock_id)
+{
+	struct bench_client *client = data;
+
+	client->clock_id = clock_id;
+}
+
+static const struct wp_presentation_listener presentation_listener = {
+	.clock_id = presentation_handle_clock_id,
+};
+
+static void registry_handle_global(void *data, struct wl_registry *registry,
+		uint32_t name, const char *interface, uint32_t version)
+{
+	struct bench_client *client = data;
+
+	if (strcmp(interface, wl_compositor_interface.name) == 0) {
+		client->compositor = wl_registry_bind(registry, name,
+				&wl_compositor_interface, 4);
+	}else if (strcmp(interface, wl_shm_interface.name) == 0) {
+		client->shm = wl_registry_bind(registry, name, &wl_shm_interface, 1);
+	}else if (strcmp(interface, xdg_wm_base_interface.name) == 0) {
+		client->wm_base = wl_registry_bind(registry, name,
+				&xdg_wm_base_interface, 1);
+		xdg_wm_base_add_listener(client->wm_base, &wm_base_listener, client);
+	}else if (strcmp(interface, wp_presentation_interface.name) == 0) {
+		client->presentation = wl_registry_bind(registry, name,
+				&wp_presentation_interface, 1);
+		wp_presentation_add_listener(client->presentation,
+				&presentation_listener, client);
+	}else if (strcmp(interface, wl_output_interface.name) == 0) {
+		struct bench_output *output = calloc(1, sizeof(*output));
+		if (output == NULL) {
+			return;
+		}
+		output->wl_output = wl_registry_bind(registry, name,
+				&wl_output_interface, 1);
+		wl_list_insert(client->outputs.prev, &output->link);
+	}
+}
+
+static void registry_handle_global_remove(void *data,
+		struct wl_registry *registry, uint32_t name)
+{
+}
+
+static const struct wl_registry_listener registry_listener = {
+	.global = registry_handle_global,
+	.global_remove = registry_handle_global_remove,
+};
+
+static int client_init_egl(struct bench_client *client)
+{
+	client->egl_display = eglGetDisplay((EGLNativeDisplayType)client->display);
+	if (client->egl_display == EGL_NO_DISPLAY ||
+			!eglInitialize(client->egl_display, NULL, NULL)) {
+		spider_err("Failed to initialize EGL\n");
+		return -1;
+	}
+	eglBindAPI(EGL_OPENGL_ES_API);
+
+	const EGLint config_attribs[] = {
+		EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_ALPHA_SIZE, 0,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+		EGL_NONE,
+	};
+	EGLint nconfigs;
+	if (!eglChooseConfig(client->egl_display, config_attribs,
+			&client->egl_config, 1, &nconfigs) || nconfigs < 1) {
+		spider_err("Failed to choose EGL config\n");
+		return -1;
+	}
+
+	const EGLint context_attribs[] = {
+		EGL_CONTEXT_CLIENT_VERSION, 2,
+		EGL_NONE,
+	};
+	client->egl_context = eglCreateContext(client->egl_display,
+			client->egl_config, EGL_NO_CONTEXT, context_attribs);
+	if (client->egl_context == EGL_NO_CONTEXT) {
+		spider_err("Failed to create EGL context\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Starts measuring once every window is up and the warmup has passed, and
+ * stops after the configured duration. */
+static void client_update(struct bench_client *client)
+{
+	struct timespec now;
+	clock_gettime(client->clock_id, &now);
+
+	if (!client->started) {
+		struct bench_window *window;
+		wl_list_for_each(window, &client->windows, link) {
+			if (!window->configured) {
+				return;
+			}
+		}
+		client->started = true;
+		client->start = now;
+		client->start.tv_sec += BENCH_WARMUP_SEC;
+		client->end = client->start;
+		client->end.tv_sec += client->options->duration;
+		return;
+	}
+
+	if (!client->measuring && timespec_to_usec(&client->start, &now) >= 0) {
+		client->measuring = true;
+		client->cpu_ticks = read_cpu_ticks(client->compositor_pid);
+		/* Have the compositor reset its stats for the measured window */
+		kill(client->compositor_pid, SIGUSR2);
+	}else if (client->measuring && timespec_to_usec(&client->end, &now) >= 0) {
+		long ticks = read_cpu_ticks(client->compositor_pid);
+		if (client->cpu_ticks >= 0 && ticks >= 0) {
+			client->cpu_ticks = ticks - client->cpu_ticks;
+		}else {
+			client->cpu_ticks = -1;
+		}
+		/* and dump them to its log when the window ends */
+		kill(client->compositor_pid, SIGUSR1);
+		client->measuring = false;
+		client->done = true;
+	}
+}
+
+static void client_report(struct bench_client *client, int fd)
+{
+	struct bench_options *options = client->options;
+	struct bench_samples *frame_times = &client->frame_times;
+	struct bench_samples *latencies = &client->latencies;
+
+	dprintf(fd, "spider-bench: %d outputs, %d shm + %d egl clients of %dx%d, ",
+			options->outputs, options->shm_clients, options->egl_clients,
+			options->width, options->height);
+	if (options->rate == 0) {
+		dprintf(fd, "frame callback paced, %d s\n", options->duration);
+	}else {
+		dprintf(fd, "%d Hz, %d s\n", options->rate, options->duration);
+	}
+
+	dprintf(fd, "frame time (ms): p50 %.2f p90 %.2f p99 %.2f max %.2f\n",
+			bench_samples_percentile(frame_times, 50) / 1000.0,
+			bench_samples_percentile(frame_times, 90) / 1000.0,
+			bench_samples_percentile(frame_times, 99) / 1000.0,
+			bench_samples_percentile(frame_times, 100) / 1000.0);
+	dprintf(fd, "latency (ms): p50 %.2f p90 %.2f p99 %.2f max %.2f\n",
+			bench_samples_percentile(latencies, 50) / 1000.0,
+			bench_samples_percentile(latencies, 90) / 1000.0,
+			bench_samples_percentile(latencies, 99) / 1000.0,
+			bench_samples_percentile(latencies, 100) / 1000.0);
+	dprintf(fd, "frames: %d committed, %d presented, %d dropped, "
+			"%d missed vblanks, %d stalled on buffers\n",
+			client->committed, client->presented, client->discarded,
+			client->missed, client->stalled);
+
+	int output_frames = 0;
+	struct bench_output *output;
+	wl_list_for_each(output, &client->outputs, link) {
+		output_frames += output->frames;
+	}
+	if (client->cpu_ticks >= 0 && output_frames > 0) {
+		double cpu_msec = client->cpu_ticks * 1000.0 / sysconf(_SC_CLK_TCK);
+		dprintf(fd, "compositor: %.0f ms cpu, %.3f ms cpu per frame "
+				"over %d output frames\n",
+				cpu_msec, cpu_msec / output_frames, output_frames);
+	}else {
+		dprintf(fd, "compositor: cpu time not available\n");
+	}
+
+	dprintf(fd, SPIDER_BENCH_END);
+}
+
+static void client_draw_all(struct bench_client *client)
+{
+	struct bench_window *window;
+	wl_list_for_each(window, &client->windows, link) {
+		window_draw(window);
+	}
+}
+
+int bench_client_run(struct bench_options *options)
+{
+	struct bench_client client = {
+		.options = options,
+		.clock_id = CLOCK_MONOTONIC,
+		.cpu_ticks = -1,
+	};
+	wl_list_init(&client.outputs);
+	wl_list_init(&client.windows);
+
+	const char *env = getenv(SPIDER_BENCH_FD);
+	int report_fd = env ? atoi(env) : STDOUT_FILENO;
+	env = getenv(SPIDER_BENCH_COMPOSITOR_PID);
+	client.compositor_pid = env ? atoi(env) : getppid();
+
+	client.display = wl_display_connect(NULL);
+	if (client.display == NULL) {
+		spider_err("Failed to connect to the compositor\n");
+		return 1;
+	}
+
+	client.registry = wl_display_get_registry(client.display);
+	wl_registry_add_listener(client.registry, &registry_listener, &client);
+	wl_display_roundtrip(client.display);
+	wl_display_roundtrip(client.display);
+	if (client.compositor == NULL || client.shm == NULL ||
+			client.wm_base == NULL) {
+		spider_err("The compositor lacks required globals\n");
+		return 1;
+	}
+	if (client.presentation == NULL) {
+		spider_err("No presentation-time support, timings are unavailable\n");
+	}
+
+	if (options->egl_clients > 0 && client_init_egl(&client) != 0) {
+		return 1;
+	}
+	for (int i = 0; i < options->shm_clients + options->egl_clients; i++) {
+		if (window_create(&client, i >= options->shm_clients) == NULL) {
+			return 1;
+		}
+	}
+
+	int timer_fd = -1;
+	if (options->rate > 0) {
+		timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+		long interval = 1000000000L / options->rate;
+		struct itimerspec spec = {
+			.it_interval = { interval / 1000000000L, interval % 1000000000L },
+			.it_value = { interval / 1000000000L, interval % 1000000000L },
+		};
+		timerfd_settime(timer_fd, 0, &spec, NULL);
+	}
+
+	struct pollfd fds[2] = {
+		{ .fd = wl_display_get_fd(client.display), .events = POLLIN },
+		{ .fd = timer_fd, .events = POLLIN },
+	};
+	int nfds = timer_fd >= 0 ? 2 : 1;
+
+	while (!client.done) {
+		while (wl_display_prepare_read(client.display) != 0) {
+			wl_display_dispatch_pending(client.display);
+		}
+		wl_display_flush(client.display);
+
+		if (poll(fds, nfds, 100) < 0 && errno != EINTR) {
+			wl_display_cancel_read(client.display);
+			spider_err("poll failed\n");
+			return 1;
+		}
+
+		if (fds[0].revents & POLLIN) {
+			if (wl_display_read_events(client.display) < 0) {
+				spider_err("Lost the compositor\n");
+				return 1;
+			}
+		}else {
+			wl_display_cancel_read(client.display);
+		}
+		wl_display_dispatch_pending(client.display);
+
+		if (nfds > 1 && (fds[1].revents & POLLIN)) {
+			uint64_t expirations;
+			if (read(timer_fd, &expirations, sizeof(expirations)) > 0) {
+				client_draw_all(&client);
+			}
+		}
+
+		client_update(&client);
+	}
+
+	client_report(&client, report_fd);
+
+	bench_samples_finish(&client.frame_times);
+	bench_samples_finish(&client.latencies);
+	wl_display_disconnect(client.display);
+	return 0;
+}
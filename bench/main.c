@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2019 Minyoung.Go <hedone21@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "bench/bench.h"
+#include "common/log.h"
+#include "common/global_vars.h"
+
+int SPIDER_LOGLEVEL = 2;
+
+static void help()
+{
+	printf("usage: spider-bench -c COMPOSITOR [options]\n"
+			"  -c, --compositor PATH  spider binary to benchmark\n"
+			"  -o, --outputs N        headless outputs (default 1)\n"
+			"  -n, --shm N            wl_shm clients (default 1)\n"
+			"  -e, --egl N            EGL clients (default 0)\n"
+			"  -r, --rate HZ          commits per second, 0 follows frame callbacks (default 0)\n"
+			"  -W, --width PX         client width (default 1280)\n"
+			"  -H, --height PX        client height (default 720)\n"
+			"  -t, --time SEC         measured duration (default 10)\n"
+			"  -f, --rgb565           wl_shm clients draw RGB565 instead of XRGB8888\n"
+			"  -O, --output-config C  compositor output config, e.g. '*:idle_refresh=on'\n"
+			"  -R, --renderer NAME    compositor renderer, e.g. pixman\n");
+}
+
+/* Starts the compositor on the headless backend with this program as its
+ * shell client, and passes on the report the client writes back. */
+static int run_driver(struct bench_options *options)
+{
+	char self[PATH_MAX];
+	ssize_t len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+	if (len < 0) {
+		spider_err("Failed to find the benchmark binary\n");
+		return 1;
+	}
+	self[len] = '\0';
+
+	char client[PATH_MAX + 128];
+	snprintf(client, sizeof(client),
+			"exec %s --client -o %d -n %d -e %d -r %d -W %d -H %d -t %d%s",
+			self, options->outputs, options->shm_clients,
+			options->egl_clients, options->rate, options->width,
+			options->height, options->duration,
+			options->rgb565 ? " -f" : "");
+
+	int fds[2];
+	if (pipe(fds) < 0) {
+		spider_err("Failed to create pipe\n");
+		return 1;
+	}
+
+	char runtime_dir[] = "/tmp/spider-bench-XXXXXX";
+	if (getenv("XDG_RUNTIME_DIR") == NULL) {
+		if (mkdtemp(runtime_dir) == NULL) {
+			spider_err("Failed to create XDG_RUNTIME_DIR\n");
+			return 1;
+		}
+		setenv("XDG_RUNTIME_DIR", runtime_dir, true);
+	}
+
+	pid_t pid = fork();
+	if (pid < 0) {
+		spider_err("Failed to fork\n");
+		return 1;
+	}else if (pid == 0) {
+		char buf[16];
+
+		close(fds[0]);
+		snprintf(buf, sizeof(buf), "%d", options->outputs);
+		setenv("WLR_BACKENDS", "headless", true);
+		setenv("WLR_HEADLESS_OUTPUTS", buf, true);
+		setenv("WLR_LIBINPUT_NO_DEVICES", "1", true);
+		snprintf(buf, sizeof(buf), "%d", fds[1]);
+		setenv(SPIDER_BENCH_FD, buf, true);
+		snprintf(buf, sizeof(buf), "%d", getpid());
+		setenv(SPIDER_BENCH_COMPOSITOR_PID, buf, true);
+
+		const char *argv[10] = {
+			options->compositor, "-s", client, "-p", "true",
+		};
+		int argc = 5;
+		if (options->output_config != NULL) {
+			argv[argc++] = "-o";
+			argv[argc++] = options->output_config;
+		}
+		if (options->renderer != NULL) {
+			argv[argc++] = "-R";
+			argv[argc++] = options->renderer;
+		}
+		execv(options->compositor, (char **)argv);
+		spider_err("Failed to run %s\n", options->compositor);
+		exit(-1);
+	}
+	close(fds[1]);
+
+	/* The compositor keeps the write end open as well, so the report is
+	 * complete once its last line arrives rather than at EOF. */
+	char report[8192];
+	size_t report_len = 0;
+	bool complete = false;
+	int timeout = (BENCH_WARMUP_SEC + options->duration + 30) * 1000;
+	struct pollfd pfd = {
+		.fd = fds[0],
+		.events = POLLIN,
+	};
+	while (!complete && report_len < sizeof(report) - 1) {
+		int ret = poll(&pfd, 1, timeout);
+		if (ret < 0 && errno == EINTR) {
+			continue;
+		}
+		if (ret <= 0) {
+			spider_err("Timed out waiting for the benchmark client\n");
+			break;
+		}
+
+		ssize_t n = read(fds[0], report + report_len,
+				sizeof(report) - 1 - report_len);
+		if (n <= 0) {
+			break;
+		}
+		report_len += n;
+		report[report_len] = '\0';
+
+		char *end = strstr(report, SPIDER_BENCH_END);
+		if (end != NULL) {
+			*end = '\0';
+			complete = true;
+		}
+	}
+	close(fds[0]);
+
+	kill(pid, SIGTERM);
+	waitpid(pid, NULL, 0);
+	if (strcmp(runtime_dir, "/tmp/spider-bench-XXXXXX") != 0) {
+		rmdir(runtime_dir);
+	}
+
+	if (!complete) {
+		spider_err("The benchmark did not complete\n");
+		return 1;
+	}
+
+	fputs(report, stdout);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench_options options = {
+		.outputs = 1,
+		.shm_clients = 1,
+		.egl_clients = 0,
+		.rate = 0,
+		.width = 1280,
+		.height = 720,
+		.duration = 10,
+	};
+	bool client = false;
+	char *loglevel;
+
+	loglevel = getenv("LOGLEVEL");
+	if (loglevel) {
+		SPIDER_LOGLEVEL = atoi(loglevel);
+	}
+
+	static struct option long_options[] = {
+		{"help", no_argument, NULL, 'h'},
+		{"client", no_argument, NULL, 'C'},
+		{"compositor", required_argument, NULL, 'c'},
+		{"outputs", required_argument, NULL, 'o'},
+		{"shm", required_argument, NULL, 'n'},
+		{"egl", required_argument, NULL, 'e'},
+		{"rate", required_argument, NULL, 'r'},
+		{"width", required_argument, NULL, 'W'},
+		{"height", required_argument, NULL, 'H'},
+		{"time", required_argument, NULL, 't'},
+		{"rgb565", no_argument, NULL, 'f'},
+		{"output-config", required_argument, NULL, 'O'},
+		{"renderer", required_argument, NULL, 'R'},
+		{0, 0, 0, 0}
+	};
+
+	int c;
+	int option_index = 0;
+	while ((c = getopt_long(argc, argv, "hc:o:n:e:r:W:H:t:fO:R:", long_options, &option_index)) != -1) {
+		switch (c) {
+		case 'C':
+			client = true;
+			break;
+		case 'c':
+			options.compositor = optarg;
+			break;
+		case 'o':
+			options.outputs = atoi(optarg);
+			break;
+		case 'n':
+			options.shm_clients = atoi(optarg);
+			break;
+		case 'e':
+			options.egl_clients = atoi(optarg);
+			break;
+		case 'r':
+			options.rate = atoi(optarg);
+			break;
+		case 'W':
+			options.width = atoi(optarg);
+			break;
+		case 'H':
+			options.height = atoi(optarg);
+			break;
+		case 't':
+			options.duration = atoi(optarg);
+			break;
+		case 'f':
+			options.rgb565 = true;
+			break;
+		case 'O':
+			options.output_config = optarg;
+			break;
+		case 'R':
+			options.renderer = optarg;
+			break;
+		case 'h': /* fall through */
+		default:
+			help();
+			return c == 'h' ? 0 : 1;
+		}
+	}
+
+	if (options.outputs < 1 || options.shm_clients < 0 ||
+			options.egl_clients < 0 || options.rate < 0 ||
+			options.width < 1 || options.height < 1 ||
+			options.duration < 1 ||
+			options.shm_clients + options.egl_clients < 1) {
+		spider_err("Invalid benchmark options\n");
+		return 1;
+	}
+
+	if (client) {
+		return bench_client_run(&options);
+	}
+
+	if (options.compositor == NULL) {
+		help();
+		return 1;
+	}
+
+	return run_driver(&options);
+}
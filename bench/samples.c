@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2019 Minyoung.Go <hedone21@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include "bench/bench.h"
+#include "common/log.h"
+
+void bench_samples_add(struct bench_samples *samples, int value)
+{
+	if (samples->len == samples->cap) {
+		size_t cap = samples->cap ? samples->cap * 2 : 1024;
+		int *values = realloc(samples->values, cap * sizeof(int));
+		if (values == NULL) {
+			spider_err("Allocation Failed\n");
+			return;
+		}
+		samples->values = values;
+		samples->cap = cap;
+	}
+
+	samples->values[samples->len++] = value;
+}
+
+static int compare_int(const void *a, const void *b)
+{
+	int x = *(const int *)a;
+	int y = *(const int *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile. Sorts the samples in place. */
+int bench_samples_percentile(struct bench_samples *samples, int percentile)
+{
+	if (samples->len == 0) {
+		return 0;
+	}
+
+	qsort(samples->values, samples->len, sizeof(int), compare_int);
+
+	size_t rank = (samples->len * percentile + 99) / 100;
+	if (rank < 1) {
+		rank = 1;
+	}
+	return samples->values[rank - 1];
+}
+
+void bench_samples_finish(struct bench_samples *samples)
+{
+	free(samples->values);
+	samples->values = NULL;
+	samples->len = samples->cap = 0;
+}
@@ -27,6 +27,9 @@
 #define SPIDER_WEB_URL_PATH 		"localhost:8080"
 #define SPIDER_PANEL_URL 		"SPIDER_PANEL_URL"
 #define SPIDER_CLIENT_SERVER_PATH 	"SPIDER_CLIENT_SERVER_PATH"
+/* Render the shell at 1/N of the screen resolution and let the compositor
+ * scale it up, e.g. SPIDER_SHELL_SCALE=2 */
+#define SPIDER_SHELL_SCALE		"SPIDER_SHELL_SCALE"
 
 /** 
  * 0: No dbg
@@ -40,6 +40,47 @@ static void scale_fullscreen(int *screen_width, int *screen_height)
 	*screen_height = gdk_screen_get_height(screen);
 }
 
+/* The compositor reports pointer and touch positions in the scaled up
+ * surface's coordinates. GTK only knows the window's real size. */
+static void scale_event_cb(GdkEvent *event, gpointer data)
+{
+	double scale = *(double *)data;
+
+	switch (event->type) {
+	case GDK_MOTION_NOTIFY:
+		event->motion.x /= scale;
+		event->motion.y /= scale;
+		break;
+	case GDK_BUTTON_PRESS:
+	case GDK_2BUTTON_PRESS:
+	case GDK_3BUTTON_PRESS:
+	case GDK_BUTTON_RELEASE:
+		event->button.x /= scale;
+		event->button.y /= scale;
+		break;
+	case GDK_SCROLL:
+		event->scroll.x /= scale;
+		event->scroll.y /= scale;
+		break;
+	case GDK_ENTER_NOTIFY:
+	case GDK_LEAVE_NOTIFY:
+		event->crossing.x /= scale;
+		event->crossing.y /= scale;
+		break;
+	case GDK_TOUCH_BEGIN:
+	case GDK_TOUCH_UPDATE:
+	case GDK_TOUCH_END:
+	case GDK_TOUCH_CANCEL:
+		event->touch.x /= scale;
+		event->touch.y /= scale;
+		break;
+	default:
+		break;
+	}
+
+	gtk_main_do_event(event);
+}
+
 static void map_win_cb(GtkWidget* widget, gpointer data)
 {
 	struct spider_shell *shell = data;
@@ -62,6 +103,8 @@ int main(int argc, char* argv[])
 	int screen_height;
 	char *url = NULL;
 	char *loglevel;
+	char *scale_env;
+	static double scale = 1.0;
 
 	loglevel = getenv("LOGLEVEL");
 	if (loglevel) {
@@ -78,6 +121,15 @@ int main(int argc, char* argv[])
 	url = getenv(SPIDER_WEB_URL);
 	spider_dbg("URL=%s\n", url);
 
+	scale_env = getenv(SPIDER_SHELL_SCALE);
+	if (scale_env) {
+		scale = atof(scale_env);
+		if (scale < 1.0) {
+			spider_err("Invalid %s=%s\n", SPIDER_SHELL_SCALE, scale_env);
+			scale = 1.0;
+		}
+	}
+
 	gdk_set_allowed_backends("wayland");
 	gtk_init(&argc, &argv);
 
@@ -85,14 +137,28 @@ int main(int argc, char* argv[])
 
 	scale_fullscreen(&screen_width, &screen_height);
 
+	if (scale > 1.0 && shell.viewporter == NULL) {
+		spider_err("No wp_viewporter, rendering at full resolution\n");
+		scale = 1.0;
+	}
+
 	window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
-	gtk_window_set_default_size(GTK_WINDOW(window), screen_width, screen_height);
+	gtk_window_set_default_size(GTK_WINDOW(window), screen_width / scale,
+			screen_height / scale);
 	gtk_window_set_decorated(GTK_WINDOW(window), FALSE);
-	gtk_window_fullscreen(GTK_WINDOW(window));
+	if (scale == 1.0) {
+		/* A fullscreen window would be sized to the screen */
+		gtk_window_fullscreen(GTK_WINDOW(window));
+	}
 	gtk_widget_realize(window);
 
 	web = WEBKIT_WEB_VIEW(webkit_web_view_new());
 	gtk_container_add(GTK_CONTAINER(window), GTK_WIDGET(web));
+	if (scale > 1.0) {
+		/* Lay the page out for the full screen size, in fewer pixels */
+		webkit_web_view_set_zoom_level(web, 1.0 / scale);
+		gdk_event_handler_set(scale_event_cb, &scale, NULL);
+	}
 
 	g_signal_connect(window, "map", G_CALLBACK(map_win_cb), &shell);
 	g_signal_connect(window, "destroy", G_CALLBACK(destroy_win_cb), NULL);
@@ -112,6 +178,14 @@ int main(int argc, char* argv[])
 	//shell.xdg_surface = xdg_wm_base_get_xdg_surface(shell.wm_base, shell.surface);
 	spider_dbg("%p\n", shell.surface);
 
+	if (scale > 1.0) {
+		struct wp_viewport *viewport =
+			wp_viewporter_get_viewport(shell.viewporter, shell.surface);
+		wp_viewport_set_destination(viewport, screen_width, screen_height);
+		spider_dbg("Render at 1/%.2f, scaled to %dx%d\n", scale,
+				screen_width, screen_height);
+	}
+
 	//spider_compositor_manager_v1_set_background(shell.compositor_manager, shell.surface);
 	gtk_widget_show_all(window);
 
@@ -26,6 +26,7 @@
 #include <gdk/gdkwayland.h>
 #include <wlr/types/wlr_layer_shell_v1.h>
 #include "protocol/spider-compositor-manager-v1-client-protocol.h"
+#include "protocol/viewporter-client-protocol.h"
 #include "protocol/xdg-shell-client-protocol.h"
 
 struct spider_shell {
@@ -37,6 +38,7 @@ struct spider_shell {
 	struct wl_seat *seat;
 	struct wl_output *output;
 	struct wlr_layer_shell *layer_shell;
+	struct wp_viewporter *viewporter;
 
 	struct xdg_wm_base *wm_base;
 	struct xdg_shell *xdg_shell;
@@ -27,11 +27,14 @@
 #include <unistd.h>
 #include "spider/compositor.h"
 #include "spider/cursor.h"
+#include "spider/idle.h"
 #include "spider/input.h"
 #include "spider/launcher.h"
 #include "spider/layer.h"
 #include "spider/seat.h"
+#include "spider/scene.h"
 #include "spider/view.h"
+#include "spider/viewporter.h"
 #include "spider/xdg_shell.h"
 #include "common/global_vars.h"
 #include "common/log.h"
@@ -79,7 +82,7 @@ static void set_background(struct wl_client *client,
 	spider_list_for_each(view, &compositor->views, link) {
 		if (view->xdg_surface->surface == wlr_surface) {
 			spider_dbg("set background %p / %p\n", view, wlr_surface);
-			view->layer = LAYER_BACKGROUND;
+			set_view_layer(view, LAYER_BACKGROUND);
 		}
 	}
 }
@@ -110,7 +113,7 @@ static void set_bar(struct wl_client *client,
 	spider_list_for_each(view, &compositor->views, link) {
 		if (view->xdg_surface->surface == wlr_surface) {
 			spider_dbg("set %s %p / %p\n", type, view, wlr_surface);
-			view->layer = LAYER_STATUS_BAR;
+			set_view_layer(view, LAYER_STATUS_BAR);
 		}
 	}
 }
@@ -137,6 +140,31 @@ static void bind_spider_compositor(struct wl_client *client,
 			&spider_compositor_implementation, compositor, NULL);
 }
 
+/* Timing statistics can be inspected on a running compositor without
+ * raising the log level: "kill -USR1 <pid>" prints them, "kill -USR2 <pid>"
+ * starts over. */
+static int handle_stats_signal(int signal, void *data)
+{
+	struct spider_compositor *compositor = data;
+	struct spider_output *output;
+
+	spider_list_for_each(output, &compositor->outputs, link) {
+		if (signal == SIGUSR1) {
+			output_dump_stats(output, stdout);
+		}else {
+			output_reset_stats(output);
+		}
+	}
+	if (signal == SIGUSR1) {
+		scene_dump_stats(compositor->scene, stdout);
+	}else {
+		scene_reset_stats(compositor->scene);
+	}
+	fflush(stdout);
+
+	return 0;
+}
+
 static void register_spider_compositor_interface(struct spider_compositor *compositor)
 {
 	if (wl_global_create(compositor->wl_display,
@@ -164,19 +192,42 @@ int init_compositor()
 
 	compositor->compositor = wlr_compositor_create(compositor->wl_display, compositor->renderer);
 	wlr_data_device_manager_create(compositor->wl_display);
+	compositor->presentation = wlr_presentation_create(compositor->wl_display,
+			compositor->backend);
+	/* Capture: screencopy copies into shm or dmabuf buffers and reports the
+	 * damage since the last copy, export-dmabuf hands out the output's
+	 * buffers without any copy. */
+	compositor->screencopy = wlr_screencopy_manager_v1_create(
+			compositor->wl_display);
+	wlr_export_dmabuf_manager_v1_create(compositor->wl_display);
+	create_viewporter(compositor->wl_display);
 
 	compositor->output_layout = wlr_output_layout_create();
 	/*
 	wlr_xdg_output_manager_v1_create(server->wl_display, compositor->layout);
-	compositor->layout_change.notify = handle_layout_change;
-	wl_signal_add(&compositor->layout->events.change, &compositor->layout_change);
 	*/
+	compositor->layout_change.notify = handle_layout_change;
+	wl_signal_add(&compositor->output_layout->events.change,
+			&compositor->layout_change);
 
 	spider_list_init(&compositor->outputs);
 	compositor->new_output.notify = handle_new_output;
 	wl_signal_add(&compositor->backend->events.new_output, &compositor->new_output);
 
+	compositor->output_manager = wlr_output_manager_v1_create(
+			compositor->wl_display);
+	compositor->output_manager_apply.notify = handle_output_manager_apply;
+	wl_signal_add(&compositor->output_manager->events.apply,
+			&compositor->output_manager_apply);
+	compositor->output_manager_test.notify = handle_output_manager_test;
+	wl_signal_add(&compositor->output_manager->events.test,
+			&compositor->output_manager_test);
+
 	spider_list_init(&compositor->views);
+	compositor->scene = scene_create(compositor);
+	if (compositor->scene == NULL) {
+		return -1;
+	}
 
 	/*
 	compositor->xdg_shell_v6 = wlr_xdg_shell_v6_create(server->wl_display);
@@ -207,6 +258,8 @@ int init_compositor()
 	wl_signal_add(&compositor->seat->events.request_set_cursor,
 			&compositor->request_cursor);
 
+	create_idle(compositor);
+
 	/* custom interface */
 	register_spider_compositor_interface(compositor);
 
@@ -247,6 +300,10 @@ int init_compositor()
 	}
 
 	compositor->wl_event_loop = wl_display_get_event_loop(compositor->wl_display);
+	wl_event_loop_add_signal(compositor->wl_event_loop, SIGUSR1,
+			handle_stats_signal, compositor);
+	wl_event_loop_add_signal(compositor->wl_event_loop, SIGUSR2,
+			handle_stats_signal, compositor);
 	//wl_event_loop_add_idle(compositor->wl_event_loop, launch_client, compositor);
 	launch_client(compositor);
 
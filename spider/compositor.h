@@ -30,12 +30,19 @@
 #include <wlr/types/wlr_cursor.h>
 #include <wlr/types/wlr_compositor.h>
 #include <wlr/types/wlr_data_device.h>
+#include <wlr/types/wlr_export_dmabuf_v1.h>
+#include <wlr/types/wlr_idle.h>
+#include <wlr/types/wlr_idle_inhibit_v1.h>
 #include <wlr/types/wlr_input_device.h>
 #include <wlr/types/wlr_keyboard.h>
 #include <wlr/types/wlr_matrix.h>
 #include <wlr/types/wlr_output.h>
 #include <wlr/types/wlr_output_layout.h>
+#include <wlr/types/wlr_output_management_v1.h>
+#include <wlr/types/wlr_output_power_management_v1.h>
 #include <wlr/types/wlr_pointer.h>
+#include <wlr/types/wlr_presentation_time.h>
+#include <wlr/types/wlr_screencopy_v1.h>
 #include <wlr/types/wlr_seat.h>
 #include <wlr/types/wlr_xcursor_manager.h>
 #include <wlr/types/wlr_xdg_shell.h>
@@ -48,6 +55,7 @@
 #include <wlr/backend.h>
 #include <xkbcommon/xkbcommon.h>
 #include <stdbool.h>
+#include "common/util.h"
 #include "spider/output.h"
 #include "spider/layer.h"
 
@@ -57,6 +65,10 @@ struct spider_options {
 	char *server;
 	bool debug;
 	bool verbose;
+	/* Composite on the CPU with pixman instead of with the GPU */
+	bool pixman;
+	/* Seconds without input before the outputs are blanked, 0 never */
+	int idle_timeout;
 };
 
 extern struct spider_options g_options;
@@ -64,9 +76,8 @@ extern struct spider_options g_options;
 /* Used to move all of the data necessary to render a surface from the top-level
  * frame handler to the per-surface render function. */
 struct render_data {
-	struct wlr_output *output;
+	struct spider_output *output;
 	struct wlr_renderer *renderer;
-	struct spider_view *view;
 	struct timespec *when;
 };
 
@@ -84,18 +95,28 @@ struct spider_compositor {
 	struct wlr_backend *backend;
 	struct wlr_backend *noop_backend;
 	struct wlr_renderer *renderer;
+	struct wlr_presentation *presentation;
+	struct wlr_screencopy_manager_v1 *screencopy;
 
 	struct wlr_xdg_shell *xdg_shell;
 	struct wl_listener new_xdg_surface;
 	struct spider_list views;
+	struct spider_scene *scene;
 
 	struct wlr_cursor *cursor;
 	struct wlr_xcursor_manager *cursor_mgr;
+	/* Name of the xcursor image shown, NULL while a client surface is */
+	const char *cursor_image;
 	struct wl_listener cursor_motion;
 	struct wl_listener cursor_motion_absolute;
 	struct wl_listener cursor_button;
 	struct wl_listener cursor_axis;
 	struct wl_listener cursor_frame;
+	/* Touch and tablets aren't handled yet, they only count as activity */
+	struct wl_listener cursor_touch_down;
+	struct wl_listener cursor_touch_motion;
+	struct wl_listener cursor_tablet_tool_axis;
+	struct wl_listener cursor_tablet_tool_tip;
 
 	struct wlr_seat *seat;
 	struct wl_listener new_input;
@@ -108,8 +129,23 @@ struct spider_compositor {
 	uint32_t resize_edges;
 
 	struct wlr_output_layout *output_layout;
+	struct wl_listener layout_change;
 	struct spider_list outputs;
 	struct wl_listener new_output;
+	struct wlr_output_manager_v1 *output_manager;
+	struct wl_listener output_manager_apply;
+	struct wl_listener output_manager_test;
+	struct wlr_output_power_manager_v1 *output_power;
+	struct wl_listener output_power_set_mode;
+
+	struct wlr_idle *idle;
+	struct wlr_idle_inhibit_manager_v1 *idle_inhibit;
+	struct wl_listener new_idle_inhibitor;
+	struct wl_event_source *idle_timer;
+	struct timespec last_activity;
+	bool idle_blanked;
+	/* An inhibitor with a mapped surface keeps the outputs on */
+	bool idle_inhibited;
 
 	int client_server_pid;
 	int client_shell_pid;
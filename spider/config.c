@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2019 Minyoung.Go <hedone21@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "spider/config.h"
+#include "common/log.h"
+
+static struct spider_list output_configs;
+
+static void init_output_config(struct spider_output_config *config)
+{
+	config->max_render_time = OUTPUT_CONFIG_UNSET;
+	config->adaptive_sync = OUTPUT_CONFIG_UNSET;
+	config->idle_refresh = OUTPUT_CONFIG_UNSET;
+	config->mode_width = OUTPUT_CONFIG_UNSET;
+	config->mode_height = OUTPUT_CONFIG_UNSET;
+	config->mode_refresh = OUTPUT_CONFIG_UNSET;
+	config->format = OUTPUT_CONFIG_UNSET;
+	config->mirror = NULL;
+}
+
+static void merge_output_config(struct spider_output_config *dst,
+		struct spider_output_config *src)
+{
+	if (src->max_render_time != OUTPUT_CONFIG_UNSET) {
+		dst->max_render_time = src->max_render_time;
+	}
+	if (src->adaptive_sync != OUTPUT_CONFIG_UNSET) {
+		dst->adaptive_sync = src->adaptive_sync;
+	}
+	if (src->idle_refresh != OUTPUT_CONFIG_UNSET) {
+		dst->idle_refresh = src->idle_refresh;
+	}
+	if (src->mode_width != OUTPUT_CONFIG_UNSET) {
+		dst->mode_width = src->mode_width;
+		dst->mode_height = src->mode_height;
+		dst->mode_refresh = src->mode_refresh;
+	}
+	if (src->format != OUTPUT_CONFIG_UNSET) {
+		dst->format = src->format;
+	}
+	if (src->mirror != NULL) {
+		dst->mirror = src->mirror;
+	}
+}
+
+static int parse_bool(const char *value, int *result)
+{
+	if (strcmp(value, "on") == 0 || strcmp(value, "true") == 0) {
+		*result = 1;
+	}else if (strcmp(value, "off") == 0 || strcmp(value, "false") == 0) {
+		*result = 0;
+	}else {
+		return -1;
+	}
+
+	return 0;
+}
+
+/* WIDTHxHEIGHT[@HZ], e.g. 1920x1080 or 2560x1440@59.951 */
+static int parse_mode(const char *value, struct spider_output_config *config)
+{
+	int width, height;
+	float hz = 0;
+	char *end;
+
+	width = strtol(value, &end, 10);
+	if (end == value || *end != 'x') {
+		return -1;
+	}
+	value = end + 1;
+	height = strtol(value, &end, 10);
+	if (end == value) {
+		return -1;
+	}
+	if (*end == '@') {
+		value = end + 1;
+		hz = strtof(value, &end);
+		if (end == value || hz <= 0) {
+			return -1;
+		}
+		if (strcmp(end, "Hz") == 0) {
+			end += 2;
+		}
+	}
+	if (*end != '\0' || width <= 0 || height <= 0) {
+		return -1;
+	}
+
+	config->mode_width = width;
+	config->mode_height = height;
+	config->mode_refresh = (int)(hz * 1000 + 0.5);
+
+	return 0;
+}
+
+static int parse_output_option(struct spider_output_config *config,
+		const char *key, const char *value)
+{
+	if (strcmp(key, "max_render_time") == 0) {
+		if (strcmp(value, "off") == 0) {
+			config->max_render_time = MAX_RENDER_TIME_OFF;
+		}else if (strcmp(value, "auto") == 0) {
+			config->max_render_time = MAX_RENDER_TIME_AUTO;
+		}else {
+			config->max_render_time = atoi(value);
+			if (config->max_render_time <= 0) {
+				spider_err("Invalid max_render_time '%s'\n", value);
+				return -1;
+			}
+		}
+	}else if (strcmp(key, "adaptive_sync") == 0) {
+		if (parse_bool(value, &config->adaptive_sync) != 0) {
+			spider_err("Invalid adaptive_sync '%s'\n", value);
+			return -1;
+		}
+	}else if (strcmp(key, "idle_refresh") == 0) {
+		if (parse_bool(value, &config->idle_refresh) != 0) {
+			spider_err("Invalid idle_refresh '%s'\n", value);
+			return -1;
+		}
+	}else if (strcmp(key, "mode") == 0) {
+		if (parse_mode(value, config) != 0) {
+			spider_err("Invalid mode '%s'\n", value);
+			return -1;
+		}
+	}else if (strcmp(key, "format") == 0) {
+		if (strcmp(value, "xrgb8888") == 0) {
+			config->format = OUTPUT_FORMAT_XRGB8888;
+		}else if (strcmp(value, "rgb565") == 0) {
+			config->format = OUTPUT_FORMAT_RGB565;
+		}else {
+			spider_err("Invalid format '%s'\n", value);
+			return -1;
+		}
+	}else if (strcmp(key, "mirror") == 0) {
+		free(config->mirror);
+		config->mirror = strdup(value);
+		if (config->mirror == NULL) {
+			spider_err("Allocation Failed\n");
+			return -1;
+		}
+	}else {
+		spider_err("Unknown output option '%s'\n", key);
+		return -1;
+	}
+
+	return 0;
+}
+
+void init_output_configs()
+{
+	spider_list_init(&output_configs);
+}
+
+int parse_output_config(const char *arg)
+{
+	const char *options = strchr(arg, ':');
+	if (options == NULL || options == arg) {
+		spider_err("Output config must look like NAME:key=value[,...]\n");
+		return -1;
+	}
+
+	struct spider_output_config *config = calloc(1, sizeof(*config));
+	char *buf = strdup(options + 1);
+	if (config == NULL || buf == NULL) {
+		spider_err("Allocation Failed\n");
+		goto error;
+	}
+	init_output_config(config);
+	config->name = strndup(arg, options - arg);
+
+	char *saveptr;
+	for (char *option = strtok_r(buf, ",", &saveptr); option != NULL;
+			option = strtok_r(NULL, ",", &saveptr)) {
+		char *value = strchr(option, '=');
+		if (value == NULL) {
+			spider_err("Missing value for output option '%s'\n", option);
+			goto error;
+		}
+		*value++ = '\0';
+
+		if (parse_output_option(config, option, value) != 0) {
+			goto error;
+		}
+	}
+
+	spider_dbg("output config for %s\n", config->name);
+	spider_list_insert_tail(&output_configs, &config->link);
+	free(buf);
+	return 0;
+
+error:
+	free(buf);
+	if (config) {
+		free(config->name);
+		free(config->mirror);
+	}
+	free(config);
+	return -1;
+}
+
+void get_output_config(const char *name, struct spider_output_config *config)
+{
+	struct spider_output_config *pos;
+
+	init_output_config(config);
+	config->name = NULL;
+
+	spider_list_for_each(pos, &output_configs, link) {
+		if (strcmp(pos->name, "*") == 0) {
+			merge_output_config(config, pos);
+		}
+	}
+	spider_list_for_each(pos, &output_configs, link) {
+		if (strcmp(pos->name, name) == 0) {
+			merge_output_config(config, pos);
+		}
+	}
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2019 Minyoung.Go <hedone21@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __SPIDER_CONFIG_H__
+#define __SPIDER_CONFIG_H__
+
+#include "common/util.h"
+
+#define OUTPUT_CONFIG_UNSET		-1
+
+#define MAX_RENDER_TIME_OFF		0
+#define MAX_RENDER_TIME_AUTO		-2
+
+#define OUTPUT_FORMAT_XRGB8888		0
+#define OUTPUT_FORMAT_RGB565		1
+
+/* Per-output settings given with "-o NAME:key=value,key=value". NAME may be
+ * "*" to match every output; settings for a named output override it. */
+struct spider_output_config {
+	struct spider_list link;
+	char *name;
+
+	/* Milliseconds reserved for rendering before the next vblank, or one of
+	 * MAX_RENDER_TIME_OFF / MAX_RENDER_TIME_AUTO. */
+	int max_render_time;
+	/* 1 to let fullscreen views drive the refresh rate, 0 to keep it fixed */
+	int adaptive_sync;
+	/* 1 to let the refresh rate drop while little is drawn */
+	int idle_refresh;
+	/* Mode to use instead of the automatically picked one. mode_refresh is
+	 * in mHz, 0 picks the highest refresh rate at that resolution. */
+	int mode_width;
+	int mode_height;
+	int mode_refresh;
+	/* Pixel format of the frames spider composites itself, one of
+	 * OUTPUT_FORMAT_* */
+	int format;
+	/* Name of the output to show a copy of, instead of a part of the
+	 * layout, or NULL */
+	char *mirror;
+};
+
+void init_output_configs();
+int parse_output_config(const char *arg);
+void get_output_config(const char *name, struct spider_output_config *config);
+
+#endif
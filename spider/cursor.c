@@ -22,15 +22,18 @@
  * SOFTWARE.
  */
 
+#include <string.h>
 #include "spider/compositor.h"
 #include "spider/cursor.h"
+#include "spider/idle.h"
 #include "spider/view.h"
 #include "common/log.h"
 
 static void process_cursor_move(struct spider_compositor *compositor, uint32_t time) {
 	/* Move the grabbed view to the new position. */
-	compositor->grabbed_view->box.x = compositor->cursor->x - compositor->grab_x;
-	compositor->grabbed_view->box.y = compositor->cursor->y - compositor->grab_y;
+	move_view(compositor->grabbed_view,
+			compositor->cursor->x - compositor->grab_x,
+			compositor->cursor->y - compositor->grab_y);
 }
 
 static void process_cursor_resize(struct spider_compositor *compositor, uint32_t time) {
@@ -40,9 +43,7 @@ static void process_cursor_resize(struct spider_compositor *compositor, uint32_t
 	 * on one or two axes, but can also move the view if you resize from the top
 	 * or left edges (or top-left corner).
 	 *
-	 * Note that I took some shortcuts here. In a more fleshed-out compositor,
-	 * you'd wait for the client to prepare a buffer at the new size, then
-	 * commit any movement that was prepared.
+	 * The view shows a stretched snapshot meanwhile, see view_resize().
 	 */
 	struct spider_view *view = compositor->grabbed_view;
 	double dx = compositor->cursor->x - compositor->grab_x;
@@ -69,11 +70,28 @@ static void process_cursor_resize(struct spider_compositor *compositor, uint32_t
 	} else if (compositor->resize_edges & WLR_EDGE_RIGHT) {
 		width += dx;
 	}
-	view->box.x = x;
-	view->box.y = y;
-	view->box.width = width;
-	view->box.height = height;
-	wlr_xdg_toplevel_set_size(view->xdg_surface, width, height);
+	if (width < 1) {
+		width = 1;
+	}
+	if (height < 1) {
+		height = 1;
+	}
+	view_resize(view, x, y, width, height);
+}
+
+/* Setting an image uploads it to the cursor plane, or damages the software
+ * cursor, on every output. Skip it if the image is already shown. */
+static void set_cursor_image(struct spider_compositor *compositor,
+		const char *name)
+{
+	if (compositor->cursor_image != NULL &&
+			strcmp(compositor->cursor_image, name) == 0) {
+		return;
+	}
+
+	wlr_xcursor_manager_set_cursor_image(
+			compositor->cursor_mgr, name, compositor->cursor);
+	compositor->cursor_image = name;
 }
 
 static void process_cursor_motion(struct spider_compositor *compositor, uint32_t time) {
@@ -96,8 +114,7 @@ static void process_cursor_motion(struct spider_compositor *compositor, uint32_t
 		/* If there's no view under the cursor, set the cursor image to a
 		 * default. This is what makes the cursor image appear when you move it
 		 * around the screen, not over any views. */
-		wlr_xcursor_manager_set_cursor_image(
-				compositor->cursor_mgr, "left_ptr", compositor->cursor);
+		set_cursor_image(compositor, "left_ptr");
 	}
 	if (surface) {
 		bool focus_changed = seat->pointer_state.focused_surface != surface;
@@ -128,6 +145,7 @@ static void compositor_cursor_motion(struct wl_listener *listener, void *data) {
 	struct spider_compositor *compositor =
 		wl_container_of(listener, compositor, cursor_motion);
 	struct wlr_event_pointer_motion *event = data;
+	idle_notify_activity(compositor);
 	/* The cursor doesn't move unless we tell it to. The cursor automatically
 	 * handles constraining the motion to the output layout, as well as any
 	 * special configuration applied for the specific input device which
@@ -149,6 +167,7 @@ static void compositor_cursor_motion_absolute(
 	struct spider_compositor *compositor =
 		wl_container_of(listener, compositor, cursor_motion_absolute);
 	struct wlr_event_pointer_motion_absolute *event = data;
+	idle_notify_activity(compositor);
 	wlr_cursor_warp_absolute(compositor->cursor, event->device, event->x, event->y);
 	process_cursor_motion(compositor, event->time_msec);
 }
@@ -159,9 +178,20 @@ static void compositor_cursor_button(struct wl_listener *listener, void *data) {
 	struct spider_compositor *compositor =
 		wl_container_of(listener, compositor, cursor_button);
 	struct wlr_event_pointer_button *event = data;
+	idle_notify_activity(compositor);
 	/* Notify the client with pointer focus that a button press has occurred */
 	wlr_seat_pointer_notify_button(compositor->seat,
 			event->time_msec, event->button, event->state);
+	if (event->state == WLR_BUTTON_RELEASED) {
+		/* If you released any buttons, we exit interactive move/resize
+		 * mode, even if the cursor ended up over no view. */
+		if (compositor->cursor_mode == SPIDER_CURSOR_RESIZE) {
+			view_end_resize(compositor->grabbed_view);
+		}
+		compositor->cursor_mode = SPIDER_CURSOR_PASSTHROUGH;
+		return;
+	}
+
 	double sx, sy;
 	struct wlr_seat *seat = compositor->seat;
 	struct wlr_surface *surface;
@@ -172,13 +202,8 @@ static void compositor_cursor_button(struct wl_listener *listener, void *data) {
 		return;
 	}
 
-	if (event->state == WLR_BUTTON_RELEASED) {
-		/* If you released any buttons, we exit interactive move/resize mode. */
-		compositor->cursor_mode = SPIDER_CURSOR_PASSTHROUGH;
-	} else {
-		/* Focus that client if the button was _pressed_ */
-		focus_view(view, surface);
-	}
+	/* Focus that client if the button was _pressed_ */
+	focus_view(view, surface);
 }
 
 static void compositor_cursor_axis(struct wl_listener *listener, void *data) {
@@ -187,12 +212,45 @@ static void compositor_cursor_axis(struct wl_listener *listener, void *data) {
 	struct spider_compositor *compositor =
 		wl_container_of(listener, compositor, cursor_axis);
 	struct wlr_event_pointer_axis *event = data;
+	idle_notify_activity(compositor);
 	/* Notify the client with pointer focus of the axis event. */
 	wlr_seat_pointer_notify_axis(compositor->seat,
 			event->time_msec, event->orientation, event->delta,
 			event->delta_discrete, event->source);
 }
 
+static void compositor_cursor_touch_down(struct wl_listener *listener,
+		void *data)
+{
+	struct spider_compositor *compositor =
+		wl_container_of(listener, compositor, cursor_touch_down);
+	idle_notify_activity(compositor);
+}
+
+static void compositor_cursor_touch_motion(struct wl_listener *listener,
+		void *data)
+{
+	struct spider_compositor *compositor =
+		wl_container_of(listener, compositor, cursor_touch_motion);
+	idle_notify_activity(compositor);
+}
+
+static void compositor_cursor_tablet_tool_axis(struct wl_listener *listener,
+		void *data)
+{
+	struct spider_compositor *compositor =
+		wl_container_of(listener, compositor, cursor_tablet_tool_axis);
+	idle_notify_activity(compositor);
+}
+
+static void compositor_cursor_tablet_tool_tip(struct wl_listener *listener,
+		void *data)
+{
+	struct spider_compositor *compositor =
+		wl_container_of(listener, compositor, cursor_tablet_tool_tip);
+	idle_notify_activity(compositor);
+}
+
 static void compositor_cursor_frame(struct wl_listener *listener, void *data) {
 	/* This event is forwarded by the cursor when a pointer emits an frame
 	 * event. Frame events are sent after regular pointer events to group
@@ -243,6 +301,19 @@ int create_cursor(struct spider_compositor *compositor)
 	wl_signal_add(&compositor->cursor->events.axis, &compositor->cursor_axis);
 	compositor->cursor_frame.notify = compositor_cursor_frame;
 	wl_signal_add(&compositor->cursor->events.frame, &compositor->cursor_frame);
+	compositor->cursor_touch_down.notify = compositor_cursor_touch_down;
+	wl_signal_add(&compositor->cursor->events.touch_down,
+			&compositor->cursor_touch_down);
+	compositor->cursor_touch_motion.notify = compositor_cursor_touch_motion;
+	wl_signal_add(&compositor->cursor->events.touch_motion,
+			&compositor->cursor_touch_motion);
+	compositor->cursor_tablet_tool_axis.notify =
+		compositor_cursor_tablet_tool_axis;
+	wl_signal_add(&compositor->cursor->events.tablet_tool_axis,
+			&compositor->cursor_tablet_tool_axis);
+	compositor->cursor_tablet_tool_tip.notify = compositor_cursor_tablet_tool_tip;
+	wl_signal_add(&compositor->cursor->events.tablet_tool_tip,
+			&compositor->cursor_tablet_tool_tip);
 
 	return 0;
 }
@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2019 Minyoung.Go <hedone21@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <time.h>
+#include "spider/compositor.h"
+#include "spider/idle.h"
+#include "spider/output.h"
+#include "common/log.h"
+
+struct spider_idle_inhibitor {
+	struct spider_compositor *compositor;
+	struct wlr_idle_inhibitor_v1 *wlr_inhibitor;
+	/* Whether the surface had a buffer at its last commit */
+	bool has_buffer;
+	struct wl_listener destroy;
+	struct wl_listener surface_commit;
+};
+
+/* Inhibitors only count while their surface shows something, so a hidden
+ * player doesn't keep the screen on. */
+static bool idle_inhibited(struct spider_compositor *compositor,
+		struct wlr_idle_inhibitor_v1 *ignore)
+{
+	struct wlr_idle_inhibitor_v1 *wlr_inhibitor;
+	spider_list_for_each(wlr_inhibitor,
+			&compositor->idle_inhibit->inhibitors, link) {
+		if (wlr_inhibitor != ignore &&
+				wlr_surface_has_buffer(wlr_inhibitor->surface)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void idle_blank(struct spider_compositor *compositor, bool blank)
+{
+	struct spider_output *output;
+
+	spider_dbg("%s outputs\n", blank ? "Blank" : "Unblank");
+	compositor->idle_blanked = blank;
+	spider_list_for_each(output, &compositor->outputs, link) {
+		/* Leave outputs alone that were turned off some other way */
+		if (blank && output->wlr_output->enabled) {
+			output->idle_blanked = output_set_power(output, false);
+		}else if (!blank && output->idle_blanked) {
+			output_set_power(output, true);
+			output->idle_blanked = false;
+		}
+	}
+}
+
+/* A video that starts playing on blanked outputs turns them back on, like
+ * input would */
+static void idle_update_inhibit(struct spider_compositor *compositor,
+		struct wlr_idle_inhibitor_v1 *ignore)
+{
+	bool inhibited = idle_inhibited(compositor, ignore);
+
+	/* Idle clients like swayidle are not notified while inhibited either */
+	wlr_idle_set_enabled(compositor->idle, compositor->seat, !inhibited);
+	if (inhibited == compositor->idle_inhibited) {
+		return;
+	}
+	compositor->idle_inhibited = inhibited;
+
+	if (inhibited && compositor->idle_blanked) {
+		idle_blank(compositor, false);
+		wl_event_source_timer_update(compositor->idle_timer,
+				g_options.idle_timeout * 1000);
+	}
+}
+
+/* The timer isn't re-armed on every input event, which would cost a syscall
+ * per pointer motion. It fires once per timeout and checks how long ago the
+ * last input was. */
+static int handle_idle_timer(void *data)
+{
+	struct spider_compositor *compositor = data;
+	int timeout_msec = g_options.idle_timeout * 1000;
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	long idle_msec = (now.tv_sec - compositor->last_activity.tv_sec) * 1000 +
+		(now.tv_nsec - compositor->last_activity.tv_nsec) / 1000000;
+
+	if (idle_msec < timeout_msec) {
+		wl_event_source_timer_update(compositor->idle_timer,
+				timeout_msec - idle_msec);
+		return 0;
+	}
+
+	if (idle_inhibited(compositor, NULL)) {
+		wl_event_source_timer_update(compositor->idle_timer, timeout_msec);
+		return 0;
+	}
+
+	/* Re-armed by the next input */
+	idle_blank(compositor, true);
+	return 0;
+}
+
+void idle_notify_activity(struct spider_compositor *compositor)
+{
+	clock_gettime(CLOCK_MONOTONIC, &compositor->last_activity);
+	wlr_idle_notify_activity(compositor->idle, compositor->seat);
+
+	struct spider_output *output;
+	spider_list_for_each(output, &compositor->outputs, link) {
+		output_notify_activity(output);
+	}
+
+	if (compositor->idle_blanked) {
+		idle_blank(compositor, false);
+		wl_event_source_timer_update(compositor->idle_timer,
+				g_options.idle_timeout * 1000);
+	}
+}
+
+static void idle_inhibitor_handle_destroy(struct wl_listener *listener, void *data)
+{
+	struct spider_idle_inhibitor *inhibitor =
+		wl_container_of(listener, inhibitor, destroy);
+
+	/* The inhibitor is still on the manager's list at this point */
+	idle_update_inhibit(inhibitor->compositor, inhibitor->wlr_inhibitor);
+	spider_list_remove(&inhibitor->destroy.link);
+	spider_list_remove(&inhibitor->surface_commit.link);
+	free(inhibitor);
+}
+
+/* The inhibitor starts or stops counting when its surface gets or drops
+ * its buffer */
+static void idle_inhibitor_handle_surface_commit(struct wl_listener *listener,
+		void *data)
+{
+	struct spider_idle_inhibitor *inhibitor =
+		wl_container_of(listener, inhibitor, surface_commit);
+
+	bool has_buffer = wlr_surface_has_buffer(inhibitor->wlr_inhibitor->surface);
+	if (has_buffer == inhibitor->has_buffer) {
+		return;
+	}
+	inhibitor->has_buffer = has_buffer;
+	idle_update_inhibit(inhibitor->compositor, NULL);
+}
+
+static void handle_new_idle_inhibitor(struct wl_listener *listener, void *data)
+{
+	struct spider_compositor *compositor =
+		wl_container_of(listener, compositor, new_idle_inhibitor);
+	struct wlr_idle_inhibitor_v1 *wlr_inhibitor = data;
+
+	struct spider_idle_inhibitor *inhibitor = calloc(1, sizeof(*inhibitor));
+	if (inhibitor == NULL) {
+		spider_err("Allocation Failed\n");
+		return;
+	}
+	inhibitor->compositor = compositor;
+	inhibitor->wlr_inhibitor = wlr_inhibitor;
+	inhibitor->destroy.notify = idle_inhibitor_handle_destroy;
+	wl_signal_add(&wlr_inhibitor->events.destroy, &inhibitor->destroy);
+	inhibitor->has_buffer = wlr_surface_has_buffer(wlr_inhibitor->surface);
+	inhibitor->surface_commit.notify = idle_inhibitor_handle_surface_commit;
+	wl_signal_add(&wlr_inhibitor->surface->events.commit,
+			&inhibitor->surface_commit);
+
+	spider_dbg("New idle inhibitor %p\n", wlr_inhibitor);
+	idle_update_inhibit(compositor, NULL);
+}
+
+static void handle_output_power_set_mode(struct wl_listener *listener, void *data)
+{
+	struct wlr_output_power_v1_set_mode_event *event = data;
+	struct spider_output *output = event->output->data;
+
+	if (output == NULL) {
+		return;
+	}
+	output_set_power(output, event->mode == ZWLR_OUTPUT_POWER_V1_MODE_ON);
+}
+
+void create_idle(struct spider_compositor *compositor)
+{
+	struct wl_event_loop *loop = wl_display_get_event_loop(compositor->wl_display);
+
+	compositor->idle = wlr_idle_create(compositor->wl_display);
+
+	compositor->idle_inhibit = wlr_idle_inhibit_v1_create(compositor->wl_display);
+	compositor->new_idle_inhibitor.notify = handle_new_idle_inhibitor;
+	wl_signal_add(&compositor->idle_inhibit->events.new_inhibitor,
+			&compositor->new_idle_inhibitor);
+
+	compositor->output_power = wlr_output_power_manager_v1_create(
+			compositor->wl_display);
+	compositor->output_power_set_mode.notify = handle_output_power_set_mode;
+	wl_signal_add(&compositor->output_power->events.set_mode,
+			&compositor->output_power_set_mode);
+
+	clock_gettime(CLOCK_MONOTONIC, &compositor->last_activity);
+	if (g_options.idle_timeout > 0) {
+		compositor->idle_timer = wl_event_loop_add_timer(loop,
+				handle_idle_timer, compositor);
+		wl_event_source_timer_update(compositor->idle_timer,
+				g_options.idle_timeout * 1000);
+	}
+}
@@ -20,7 +20,9 @@
 
 #include <signal.h>
 #include "spider/compositor.h"
+#include "spider/idle.h"
 #include "spider/input.h"
+#include "spider/scene.h"
 #include "spider/view.h"
 #include "common/log.h"
 
@@ -75,6 +77,7 @@ static bool handle_keybinding(struct spider_compositor *compositor, xkb_keysym_t
 			/* Move the previous view to the end of the list */
 			spider_list_remove(&current_view->link);
 			spider_list_insert(compositor->views.prev, &current_view->link);
+			scene_node_lower_to_bottom(current_view->node);
 			break;
 		default:
 			return false;
@@ -91,6 +94,8 @@ static void handle_keyboard_key(struct wl_listener *listener, void *data)
 	struct wlr_event_keyboard_key *event = data;
 	struct wlr_seat *seat = compositor->seat;
 
+	idle_notify_activity(compositor);
+
 	/* Translate libinput keycode -> xkbcommon */
 	uint32_t keycode = event->keycode + 8;
 	/* Get a list of keysyms based on the keymap for this keyboard */
@@ -168,6 +173,9 @@ void handle_new_input(struct wl_listener *listener, void *data)
 			add_new_keyboard(compositor, device);
 			break;
 		case WLR_INPUT_DEVICE_POINTER:
+		case WLR_INPUT_DEVICE_TOUCH:
+		case WLR_INPUT_DEVICE_TABLET_TOOL:
+			/* The cursor aggregates touch and tablet events too */
 			add_new_pointer(compositor, device);
 			break;
 		default:
@@ -20,12 +20,14 @@
  * SOFTWARE.
  */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
 #include <getopt.h>
 #include <linux/limits.h>
 #include "spider/compositor.h"
+#include "spider/config.h"
 #include "common/log.h"
 #include "common/global_vars.h"
 
@@ -38,7 +40,17 @@ struct spider_options g_options = {
 
 void help()
 {
-	/* TODO */
+	printf("usage: spider [options]\n"
+			"  -h, --help              show this help\n"
+			"  -d, --debug             log wlroots info messages\n"
+			"  -V, --verbose           log wlroots debug messages\n"
+			"  -v, --version           show the version\n"
+			"  -p, --panel PATH        panel client to launch\n"
+			"  -s, --shell PATH        shell client to launch\n"
+			"  -r, --server CMD        command run with /bin/sh once the compositor is up\n"
+			"  -o, --output CONFIG     output config NAME:key=value[,key=value...], e.g. '*:max_render_time=auto'\n"
+			"  -R, --renderer NAME     gl (default) or pixman\n"
+			"  -i, --idle-timeout SEC  blank the outputs after SEC seconds without input, 0 never (default 0)\n");
 }
 
 int main(int argc, char *argv[]) 
@@ -53,12 +65,17 @@ int main(int argc, char *argv[])
 		{"panel", required_argument, NULL, 'p'},
 		{"shell", required_argument, NULL, 's'},
 		{"server", required_argument, NULL, 'r'},
+		{"output", required_argument, NULL, 'o'},
+		{"renderer", required_argument, NULL, 'R'},
+		{"idle-timeout", required_argument, NULL, 'i'},
 		{0, 0, 0, 0}
 	};
 
+	init_output_configs();
+
 	int c;
 	int option_index = 0;
-	while ((c = getopt_long(argc, argv, "hdVvp:s:r:", long_options, &option_index)) != -1) {
+	while ((c = getopt_long(argc, argv, "hdVvp:s:r:o:R:i:", long_options, &option_index)) != -1) {
 		int arglen;
 
 		switch (c) {
@@ -69,7 +86,8 @@ int main(int argc, char *argv[])
 			g_options.verbose = true;
 			break;
 		case 'v':
-			/* TODO */
+			printf("spider %s\n", SPIDER_VERSION);
+			return 0;
 		case 'p':
 			arglen = strlen(optarg);
 			if (arglen >= PATH_MAX) {
@@ -98,6 +116,26 @@ int main(int argc, char *argv[])
 			g_options.server = malloc(sizeof(char) * (arglen + 1));
 			strcpy(g_options.server, optarg);
 			break;
+		case 'o':
+			if (parse_output_config(optarg) != 0) {
+				return -1;
+			}
+			break;
+		case 'R':
+			if (strcmp(optarg, "pixman") == 0) {
+				g_options.pixman = true;
+			}else if (strcmp(optarg, "gl") != 0) {
+				spider_err("Unknown renderer '%s'\n", optarg);
+				return -1;
+			}
+			break;
+		case 'i':
+			g_options.idle_timeout = atoi(optarg);
+			if (g_options.idle_timeout < 0) {
+				spider_err("Invalid idle timeout '%s'\n", optarg);
+				return -1;
+			}
+			break;
 		case 'h': /* fall through */
 		default:
 			help();
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2019 Minyoung.Go <hedone21@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <GLES2/gl2.h>
+#include <wlr/render/egl.h>
+#include <wlr/render/gles2.h>
+#include "spider/offscreen.h"
+#include "common/log.h"
+
+/* Returns whether the texture can be drawn into, creating or resizing it
+ * first if needed. The content of a new texture is undefined. */
+bool offscreen_ensure(struct spider_offscreen *offscreen,
+		struct wlr_renderer *renderer, int width, int height, bool *created)
+{
+	*created = false;
+	if (offscreen->failed || !wlr_renderer_is_gles2(renderer)) {
+		return false;
+	}
+
+	if (offscreen->texture != NULL) {
+		int texture_width, texture_height;
+		wlr_texture_get_size(offscreen->texture,
+				&texture_width, &texture_height);
+		if (texture_width == width && texture_height == height) {
+			return true;
+		}
+		offscreen_finish(offscreen, renderer);
+	}
+
+	offscreen->texture = wlr_texture_from_pixels(renderer,
+			WL_SHM_FORMAT_XBGR8888, width * 4, width, height, NULL);
+	if (offscreen->texture == NULL) {
+		goto failed;
+	}
+
+	struct wlr_gles2_texture_attribs attribs;
+	wlr_gles2_texture_get_attribs(offscreen->texture, &attribs);
+
+	GLint previous;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+	glGenFramebuffers(1, &offscreen->fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, offscreen->fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+			attribs.target, attribs.tex, 0);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, previous);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		spider_err("Offscreen framebuffer incomplete: 0x%x\n", status);
+		goto failed;
+	}
+
+	*created = true;
+	return true;
+
+failed:
+	spider_err("Failed to create a %dx%d offscreen buffer\n", width, height);
+	offscreen_finish(offscreen, renderer);
+	offscreen->failed = true;
+	return false;
+}
+
+/* Draws into the texture until offscreen_unbind(). Binds nest. */
+void offscreen_bind(struct spider_offscreen *offscreen)
+{
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &offscreen->previous_fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, offscreen->fbo);
+}
+
+void offscreen_unbind(struct spider_offscreen *offscreen)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, offscreen->previous_fbo);
+}
+
+void offscreen_finish(struct spider_offscreen *offscreen,
+		struct wlr_renderer *renderer)
+{
+	if (offscreen->fbo != 0) {
+		wlr_egl_make_current(wlr_gles2_renderer_get_egl(renderer),
+				EGL_NO_SURFACE, NULL);
+		glDeleteFramebuffers(1, &offscreen->fbo);
+		offscreen->fbo = 0;
+	}
+	if (offscreen->texture != NULL) {
+		wlr_texture_destroy(offscreen->texture);
+		offscreen->texture = NULL;
+	}
+}
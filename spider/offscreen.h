@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2019 Minyoung.Go <hedone21@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __SPIDER_OFFSCREEN_H__
+#define __SPIDER_OFFSCREEN_H__
+
+#include <stdbool.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/render/wlr_texture.h>
+
+/* A texture the GLES2 renderer can draw into. wlroots can't render to a
+ * texture, but it does draw into whatever framebuffer is bound. The texture
+ * is allocated through wlroots so that it can be drawn like any other, and
+ * attached to a framebuffer of our own. It has the size of an output buffer
+ * so that the output's matrices and scissors apply as is. */
+struct spider_offscreen {
+	struct wlr_texture *texture;
+	unsigned int fbo;
+	int previous_fbo;
+	/* Creating it failed, don't try again */
+	bool failed;
+};
+
+bool offscreen_ensure(struct spider_offscreen *offscreen,
+		struct wlr_renderer *renderer, int width, int height, bool *created);
+void offscreen_bind(struct spider_offscreen *offscreen);
+void offscreen_unbind(struct spider_offscreen *offscreen);
+void offscreen_finish(struct spider_offscreen *offscreen,
+		struct wlr_renderer *renderer);
+
+#endif
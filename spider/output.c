@@ -20,128 +20,1709 @@
  * SOFTWARE.
  */
 
+#include <inttypes.h>
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+#include <GLES2/gl2.h>
+#include <wlr/render/gles2.h>
+#include <wlr/backend/drm.h>
+#include <wlr/types/wlr_output_damage.h>
+#include <wlr/types/wlr_output_management_v1.h>
 #include <wlr/types/wlr_presentation_time.h>
+#include <wlr/types/wlr_screencopy_v1.h>
+#include <wlr/util/region.h>
 #include "spider/compositor.h"
+#include "spider/config.h"
+#include "spider/offscreen.h"
 #include "spider/output.h"
+#include "spider/pixman_render.h"
+#include "spider/scene.h"
+#include "spider/surface.h"
 #include "spider/view.h"
+#include "spider/viewporter.h"
 #include "common/log.h"
 
+static void scissor_output(struct wlr_output *wlr_output, pixman_box32_t *rect)
+{
+	struct wlr_renderer *renderer = wlr_backend_get_renderer(wlr_output->backend);
+
+	struct wlr_box box = {
+		.x = rect->x1,
+		.y = rect->y1,
+		.width = rect->x2 - rect->x1,
+		.height = rect->y2 - rect->y1,
+	};
+
+	int ow, oh;
+	wlr_output_transformed_resolution(wlr_output, &ow, &oh);
+
+	enum wl_output_transform transform =
+		wlr_output_transform_invert(wlr_output->transform);
+	wlr_box_transform(&box, &box, transform, ow, oh);
+
+	wlr_renderer_scissor(renderer, &box);
+}
+
+/* Computes a box in output-local coordinates, scaled to the output buffer,
+ * from a box in layout coordinates. */
+static void output_layout_box(struct spider_output *output,
+		double lx, double ly, int width, int height, struct wlr_box *box)
+{
+	struct wlr_output *wlr_output = output->wlr_output;
+
+	box->x = (lx - output->lx) * wlr_output->scale;
+	box->y = (ly - output->ly) * wlr_output->scale;
+	box->width = width * wlr_output->scale;
+	box->height = height * wlr_output->scale;
+}
+
+void output_node_box(struct spider_output *output,
+		struct spider_node *node, struct wlr_box *box)
+{
+	output_layout_box(output, node->lx, node->ly,
+			node->width, node->height, box);
+}
+
+/* wlroots' GLES2 renderer blends every draw. Where a surface is opaque that
+ * only costs a read of the destination, which tiled GPUs pay for in memory
+ * bandwidth, so it is turned off around those draws. */
+static void renderer_set_blending(struct wlr_renderer *renderer, bool enable)
+{
+	if (!wlr_renderer_is_gles2(renderer)) {
+		return;
+	}
+
+	if (enable) {
+		glEnable(GL_BLEND);
+	}else {
+		glDisable(GL_BLEND);
+	}
+}
+
 /* This function is called for every surface that needs to be rendered. */
-static void render_surface(struct wlr_surface *surface,	int sx, int sy, void *data)
+static void render_surface(struct spider_node *node, void *data)
+{
+	struct render_data *rdata = data;
+	struct spider_output *output = rdata->output;
+	struct wlr_output *wlr_output = output->wlr_output;
+	struct wlr_surface *surface = node->surface;
+
+	if (!pixman_region32_not_empty(&node->visible)) {
+		return;
+	}
+
+	struct wlr_texture *texture = scene_node_get_texture(node);
+	if (texture == NULL) {
+		return;
+	}
+
+	struct wlr_box box;
+	output_node_box(output, node, &box);
+	/* Drawing is clipped to node->visible, which crops the buffer to the
+	 * viewport's source. A snapshot is stretched to the box as a whole. */
+	if (node->snapshot == NULL) {
+		viewport_buffer_box(surface, &box);
+	}
+
+	/*
+	spider_dbg("box x=%d y=%d width=%d height=%d\n", 
+			box.x, box.y, box.width, box.height);
+	*/
+
+	float matrix[9];
+	enum wl_output_transform transform =
+		wlr_output_transform_invert(surface->current.transform);
+	wlr_matrix_project_box(matrix, &box, transform, 0,
+			wlr_output->transform_matrix);
+
+	pixman_region32_t translucent;
+	pixman_region32_init(&translucent);
+	pixman_region32_subtract(&translucent, &node->visible,
+			&node->visible_opaque);
+
+	int nrects;
+	pixman_box32_t *rects = pixman_region32_rectangles(&translucent, &nrects);
+	for (int i = 0; i < nrects; ++i) {
+		scissor_output(wlr_output, &rects[i]);
+		wlr_render_texture_with_matrix(rdata->renderer, texture, matrix, 1);
+	}
+	pixman_region32_fini(&translucent);
+
+	rects = pixman_region32_rectangles(&node->visible_opaque, &nrects);
+	if (nrects == 0) {
+		return;
+	}
+	renderer_set_blending(rdata->renderer, false);
+	for (int i = 0; i < nrects; ++i) {
+		scissor_output(wlr_output, &rects[i]);
+		wlr_render_texture_with_matrix(rdata->renderer, texture, matrix, 1);
+	}
+	renderer_set_blending(rdata->renderer, true);
+}
+
+struct opaque_data {
+	struct spider_output *output;
+	pixman_region32_t *damage;
+	pixman_region32_t *opaque;
+};
+
+/* Called top to bottom. Whatever part of the damage is not yet covered by an
+ * opaque surface above is where this surface has to be drawn. */
+static void node_opaque_iterator(struct spider_node *node, void *data)
+{
+	struct opaque_data *odata = data;
+	struct wlr_output *wlr_output = odata->output->wlr_output;
+	struct wlr_surface *surface = node->surface;
+
+	pixman_region32_clear(&node->visible);
+	pixman_region32_clear(&node->visible_opaque);
+	if (!scene_node_on_output(node, odata->output) ||
+			scene_node_get_texture(node) == NULL) {
+		return;
+	}
+
+	struct wlr_box box;
+	output_node_box(odata->output, node, &box);
+
+	pixman_region32_intersect_rect(&node->visible, odata->damage,
+			box.x, box.y, box.width, box.height);
+	pixman_region32_subtract(&node->visible, &node->visible, odata->opaque);
+	if (!pixman_region32_not_empty(&node->visible)) {
+		return;
+	}
+
+	bool is_opaque = node->snapshot != NULL ?
+		wlr_texture_is_opaque(node->snapshot->texture) :
+		surface_is_opaque(surface);
+	if (is_opaque) {
+		pixman_region32_copy(&node->visible_opaque, &node->visible);
+		pixman_region32_union_rect(odata->opaque, odata->opaque,
+				box.x, box.y, box.width, box.height);
+		return;
+	}
+
+	/* Fractional scales would round the region outwards, and culling a
+	 * pixel that is actually translucent is worse than overdrawing it. The
+	 * opaque region doesn't match a stretched snapshot either. */
+	if (ceil(wlr_output->scale) != wlr_output->scale ||
+			node->snapshot != NULL) {
+		return;
+	}
+
+	pixman_region32_t opaque;
+	pixman_region32_init(&opaque);
+	wlr_region_scale(&opaque, &surface->opaque_region, wlr_output->scale);
+	pixman_region32_intersect_rect(&opaque, &opaque, 0, 0,
+			box.width, box.height);
+	pixman_region32_translate(&opaque, box.x, box.y);
+	pixman_region32_intersect(&node->visible_opaque, &node->visible, &opaque);
+	pixman_region32_union(odata->opaque, odata->opaque, &opaque);
+	pixman_region32_fini(&opaque);
+}
+
+/* Walks the scene top to bottom to find how much of the damage each surface
+ * can still be seen through, so that surfaces hidden behind opaque ones are
+ * not drawn at all. Leaves that in node->visible and the area the surfaces
+ * cover in opaque. */
+static void output_cull_scene(struct spider_output *output,
+		pixman_region32_t *damage, pixman_region32_t *opaque)
+{
+	struct opaque_data odata = {
+		.output = output,
+		.damage = damage,
+		.opaque = opaque,
+	};
+	scene_for_each_surface_reverse(output->compositor->scene,
+			node_opaque_iterator, &odata);
+}
+
+static void node_visible_iterator(struct spider_node *node, void *data)
+{
+	pixman_region32_t *visible = data;
+	pixman_region32_union(visible, visible, &node->visible);
+}
+
+static void output_clear(struct spider_output *output, pixman_region32_t *region)
+{
+	struct wlr_renderer *renderer = output->compositor->renderer;
+
+	float color[4] = {0.0, 0.0, 0.0, 1.0};
+	int nrects;
+	pixman_box32_t *rects = pixman_region32_rectangles(region, &nrects);
+	for (int i = 0; i < nrects; ++i) {
+		scissor_output(output->wlr_output, &rects[i]);
+		wlr_renderer_clear(renderer, color);
+	}
+}
+
+/* Redraws the out of date part of the layer cache, the same way the scene is
+ * drawn on the output. */
+static void output_update_layer_cache(struct spider_output *output,
+		struct render_data *rdata)
+{
+	struct spider_scene *scene = output->compositor->scene;
+
+	int width, height;
+	wlr_output_transformed_resolution(output->wlr_output, &width, &height);
+	pixman_region32_intersect_rect(&output->layer_cache_dirty,
+			&output->layer_cache_dirty, 0, 0, width, height);
+	if (!pixman_region32_not_empty(&output->layer_cache_dirty)) {
+		return;
+	}
+
+	pixman_region32_t opaque, background;
+	pixman_region32_init(&opaque);
+	pixman_region32_init(&background);
+	struct opaque_data odata = {
+		.output = output,
+		.damage = &output->layer_cache_dirty,
+		.opaque = &opaque,
+	};
+	scene_for_each_layer_surface_reverse(scene, 0, LAYER_CACHE_TOP,
+			node_opaque_iterator, &odata);
+	pixman_region32_subtract(&background, &output->layer_cache_dirty, &opaque);
+
+	offscreen_bind(&output->layer_cache);
+	output_clear(output, &background);
+	scene_for_each_layer_surface(scene, 0, LAYER_CACHE_TOP,
+			render_surface, rdata);
+	offscreen_unbind(&output->layer_cache);
+
+	pixman_region32_clear(&output->layer_cache_dirty);
+	pixman_region32_fini(&background);
+	pixman_region32_fini(&opaque);
+}
+
+/* Copies region from an offscreen texture that holds a whole output buffer,
+ * stretched over this output. It is projected like a client buffer with the
+ * transform of the output it was drawn for, which is this output or the
+ * source of a mirror. wlroots doesn't flip framebuffers of its own, so the
+ * texture is upside down and gets flipped back. */
+static void output_render_buffer(struct spider_output *output,
+		struct wlr_texture *texture, enum wl_output_transform transform,
+		pixman_region32_t *region)
+{
+	struct wlr_output *wlr_output = output->wlr_output;
+	struct wlr_renderer *renderer = output->compositor->renderer;
+
+	int width, height;
+	wlr_output_transformed_resolution(wlr_output, &width, &height);
+	struct wlr_box box = {
+		.width = width,
+		.height = height,
+	};
+	static const float flip[9] = {
+		1.0f, 0.0f, 0.0f,
+		0.0f, -1.0f, 1.0f,
+		0.0f, 0.0f, 1.0f,
+	};
+	float matrix[9];
+	wlr_matrix_project_box(matrix, &box, wlr_output_transform_invert(transform),
+			0, wlr_output->transform_matrix);
+	wlr_matrix_multiply(matrix, matrix, flip);
+
+	renderer_set_blending(renderer, false);
+	int nrects;
+	pixman_box32_t *rects = pixman_region32_rectangles(region, &nrects);
+	for (int i = 0; i < nrects; ++i) {
+		scissor_output(wlr_output, &rects[i]);
+		wlr_render_texture_with_matrix(renderer, texture, matrix, 1);
+	}
+	renderer_set_blending(renderer, true);
+}
+
+/* Draws the scene on an output bottom to top, limited to the damaged area. */
+static void output_render_scene(struct spider_output *output,
+		pixman_region32_t *damage, struct timespec *when)
+{
+	struct spider_compositor *compositor = output->compositor;
+	struct wlr_renderer *renderer = compositor->renderer;
+
+	pixman_region32_t opaque;
+	pixman_region32_init(&opaque);
+	output_cull_scene(output, damage, &opaque);
+
+	/* Only clear what no opaque surface is going to paint over. */
+	pixman_region32_t background;
+	pixman_region32_init(&background);
+	pixman_region32_subtract(&background, damage, &opaque);
+
+	struct render_data rdata = {
+		.output = output,
+		.renderer = renderer,
+		.when = when,
+	};
+
+	/* The cache holds the cleared background too, so it is copied wherever
+	 * the layers above don't cover the damage. It isn't used, or updated,
+	 * while those layers hide the cached ones completely. */
+	pixman_region32_t cached;
+	pixman_region32_init(&cached);
+	scene_for_each_layer_surface(compositor->scene, 0, LAYER_CACHE_TOP,
+			node_visible_iterator, &cached);
+	bool created;
+	if (pixman_region32_not_empty(&cached) &&
+			offscreen_ensure(&output->layer_cache, renderer,
+				output->wlr_output->width, output->wlr_output->height,
+				&created)) {
+		if (created) {
+			/* Whatever was drawn from the old cache is redrawn */
+			int width, height;
+			wlr_output_transformed_resolution(output->wlr_output,
+					&width, &height);
+			pixman_region32_union_rect(&output->layer_cache_dirty,
+					&output->layer_cache_dirty, 0, 0, width, height);
+			output_damage_whole(output);
+		}
+		pixman_region32_union(&cached, &cached, &background);
+		output_update_layer_cache(output, &rdata);
+		output_render_buffer(output, output->layer_cache.texture,
+				output->wlr_output->transform, &cached);
+		scene_for_each_layer_surface(compositor->scene,
+				LAYER_CACHE_TOP + 1, MAX_LAYER_POSITION - 1,
+				render_surface, &rdata);
+	}else {
+		output_clear(output, &background);
+		scene_for_each_surface(compositor->scene, render_surface, &rdata);
+	}
+
+	pixman_region32_fini(&cached);
+	pixman_region32_fini(&background);
+	pixman_region32_fini(&opaque);
+}
+
+static bool output_is_mirror_of(struct spider_output *output,
+		struct spider_output *source)
+{
+	return output->config.mirror != NULL && output->wlr_output->enabled &&
+		strcmp(output->config.mirror, source->wlr_output->name) == 0;
+}
+
+static bool output_has_mirrors(struct spider_output *output)
+{
+	struct spider_output *mirror;
+	spider_list_for_each(mirror, &output->compositor->outputs, link) {
+		if (output_is_mirror_of(mirror, output)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* Returns the output a mirror shows, if it is there. Mirrors of mirrors
+ * aren't supported. */
+static struct spider_output *output_mirror_source(struct spider_output *output)
+{
+	struct spider_output *source;
+	spider_list_for_each(source, &output->compositor->outputs, link) {
+		if (source->config.mirror == NULL &&
+				strcmp(source->wlr_output->name, output->config.mirror) == 0) {
+			return source;
+		}
+	}
+
+	return NULL;
+}
+
+/* Damages the mirrors of an output where its frame changed. changed is in
+ * the output's coordinates. Mirrors draw the output's frame stretched over
+ * their own transformed resolution, so it is only scaled. */
+static void output_damage_mirrors(struct spider_output *output,
+		pixman_region32_t *changed)
+{
+	int width, height;
+	wlr_output_transformed_resolution(output->wlr_output, &width, &height);
+
+	struct spider_output *mirror;
+	spider_list_for_each(mirror, &output->compositor->outputs, link) {
+		if (!output_is_mirror_of(mirror, output) || mirror->damage == NULL) {
+			continue;
+		}
+
+		int mirror_width, mirror_height;
+		wlr_output_transformed_resolution(mirror->wlr_output,
+				&mirror_width, &mirror_height);
+		double sx = (double)mirror_width / width;
+		double sy = (double)mirror_height / height;
+
+		/* Scaled rectangles are grown by a pixel for the filtering */
+		pixman_region32_t damage;
+		pixman_region32_init(&damage);
+		int nrects;
+		pixman_box32_t *rects = pixman_region32_rectangles(changed, &nrects);
+		for (int i = 0; i < nrects; ++i) {
+			int x1 = floor(rects[i].x1 * sx) - 1;
+			int y1 = floor(rects[i].y1 * sy) - 1;
+			int x2 = ceil(rects[i].x2 * sx) + 1;
+			int y2 = ceil(rects[i].y2 * sy) + 1;
+			pixman_region32_union_rect(&damage, &damage,
+					x1, y1, x2 - x1, y2 - y1);
+		}
+		wlr_output_damage_add(mirror->damage, &damage);
+		pixman_region32_fini(&damage);
+	}
+}
+
+/* Damages a mirror that was just added or enabled. Its source may have had
+ * no mirrors so far, and so no frame to copy from, which it has to
+ * composite in full first. */
+static void output_damage_mirror(struct spider_output *mirror)
+{
+	output_damage_whole(mirror);
+
+	struct spider_output *source = output_mirror_source(mirror);
+	if (source != NULL) {
+		output_damage_whole(source);
+	}
+}
+
+/* Mirrors scanning out the output's previous buffer aren't damaged by a new
+ * one, so they are asked for a frame to pick it up. */
+static void output_schedule_mirrors(struct spider_output *output)
+{
+	struct spider_output *mirror;
+	spider_list_for_each(mirror, &output->compositor->outputs, link) {
+		if (output_is_mirror_of(mirror, output)) {
+			wlr_output_schedule_frame(mirror->wlr_output);
+		}
+	}
+}
+
+/* Composites what changed since the last frame into the frame texture once,
+ * for this output and its mirrors to copy from. damage covers the buffer's
+ * age, which may be more than what changed. */
+static void output_render_scene_mirrored(struct spider_output *output,
+		pixman_region32_t *damage, struct timespec *when)
+{
+	struct wlr_output *wlr_output = output->wlr_output;
+	struct wlr_renderer *renderer = output->compositor->renderer;
+
+	bool created;
+	if (!offscreen_ensure(&output->frame, renderer,
+				wlr_output->width, wlr_output->height, &created)) {
+		output_render_scene(output, damage, when);
+		return;
+	}
+
+	pixman_region32_t changed;
+	pixman_region32_init(&changed);
+	if (created) {
+		int width, height;
+		wlr_output_transformed_resolution(wlr_output, &width, &height);
+		pixman_region32_union_rect(&changed, &changed, 0, 0, width, height);
+	}else {
+		pixman_region32_copy(&changed, &output->damage->current);
+	}
+
+	if (pixman_region32_not_empty(&changed)) {
+		offscreen_bind(&output->frame);
+		output_render_scene(output, &changed, when);
+		offscreen_unbind(&output->frame);
+		output_damage_mirrors(output, &changed);
+	}
+	pixman_region32_fini(&changed);
+
+	output_render_buffer(output, output->frame.texture, wlr_output->transform,
+			damage);
+}
+
+/* Copies region from a pixman shadow, which is in the transformed
+ * coordinates of the output it was composited for, stretched over this
+ * output's transformed resolution. */
+static void output_render_shadow(struct spider_output *output,
+		struct wlr_texture *shadow, pixman_region32_t *region)
+{
+	struct wlr_output *wlr_output = output->wlr_output;
+	struct wlr_renderer *renderer = output->compositor->renderer;
+
+	int width, height;
+	wlr_output_transformed_resolution(wlr_output, &width, &height);
+	struct wlr_box box = {
+		.width = width,
+		.height = height,
+	};
+	float matrix[9];
+	wlr_matrix_project_box(matrix, &box, WL_OUTPUT_TRANSFORM_NORMAL, 0,
+			wlr_output->transform_matrix);
+
+	/* The shadow has no alpha channel */
+	renderer_set_blending(renderer, false);
+	int nrects;
+	pixman_box32_t *rects = pixman_region32_rectangles(region, &nrects);
+	for (int i = 0; i < nrects; ++i) {
+		scissor_output(wlr_output, &rects[i]);
+		wlr_render_texture_with_matrix(renderer, shadow, matrix, 1);
+	}
+	renderer_set_blending(renderer, true);
+}
+
+/* Composites what changed since the last frame into the shadow image on the
+ * CPU, then copies the damaged part of the buffer from it. damage covers the
+ * buffer's age, which may be more than what changed. */
+static void output_render_scene_pixman(struct spider_output *output,
+		pixman_region32_t *damage)
+{
+	struct wlr_output *wlr_output = output->wlr_output;
+
+	int width, height;
+	wlr_output_transformed_resolution(wlr_output, &width, &height);
+
+	pixman_region32_t changed;
+	pixman_region32_init(&changed);
+	if (pixman_render_ensure_shadow(output, width, height)) {
+		pixman_region32_union_rect(&changed, &changed, 0, 0, width, height);
+	}else {
+		pixman_region32_copy(&changed, &output->damage->current);
+	}
+
+	if (pixman_region32_not_empty(&changed)) {
+		pixman_region32_t opaque;
+		pixman_region32_init(&opaque);
+		output_cull_scene(output, &changed, &opaque);
+		pixman_render_scene(output, &changed, &opaque);
+		pixman_region32_fini(&opaque);
+		output_damage_mirrors(output, &changed);
+	}
+	pixman_region32_fini(&changed);
+
+	if (output->shadow_texture != NULL) {
+		output_render_shadow(output, output->shadow_texture, damage);
+	}
+}
+
+static int64_t timespec_to_usec(const struct timespec *a,
+		const struct timespec *b)
+{
+	return (int64_t)(b->tv_sec - a->tv_sec) * 1000000 +
+		(b->tv_nsec - a->tv_nsec) / 1000;
+}
+
+struct frame_done_data {
+	struct spider_output *output;
+	struct timespec *when;
+	/* Only send to hidden surfaces, from the hidden frame timer */
+	bool hidden_only;
+	/* Area covered by opaque surfaces above the current one */
+	pixman_region32_t opaque;
+	/* Milliseconds until the next hidden surface is due, or 0 */
+	int hidden_due_msec;
+};
+
+/* Called top to bottom. A surface that can't be seen because opaque surfaces
+ * cover it only gets a frame event every HIDDEN_FRAME_INTERVAL_MSEC, from
+ * the hidden frame timer if nothing else repaints the output. Clients then
+ * stop drawing frames nobody sees, whose buffers would have to be uploaded
+ * on the compositor's thread all the same. */
+static void send_frame_done_iterator(struct spider_node *node, void *data)
+{
+	struct frame_done_data *fdata = data;
+	struct spider_output *output = fdata->output;
+
+	if (!scene_node_on_output(node, output)) {
+		return;
+	}
+
+	struct wlr_box box;
+	output_node_box(output, node, &box);
+	pixman_box32_t rect = {
+		.x1 = box.x,
+		.y1 = box.y,
+		.x2 = box.x + box.width,
+		.y2 = box.y + box.height,
+	};
+	bool hidden = output->index >= 0 &&
+		node->outputs == 1u << output->index &&
+		pixman_region32_contains_rectangle(&fdata->opaque, &rect) ==
+			PIXMAN_REGION_IN;
+	if (!hidden && surface_is_opaque(node->surface)) {
+		pixman_region32_union_rect(&fdata->opaque, &fdata->opaque,
+				box.x, box.y, box.width, box.height);
+	}
+
+	/* A surface spanning several outputs would otherwise be asked to draw
+	 * once per output and refresh. */
+	if (node->primary_output != output) {
+		return;
+	}
+
+	if (!hidden && fdata->hidden_only) {
+		return;
+	}
+	int64_t usec = timespec_to_usec(&node->last_frame_done, fdata->when);
+	if (hidden && usec < HIDDEN_FRAME_INTERVAL_MSEC * 1000) {
+		int due_msec = (HIDDEN_FRAME_INTERVAL_MSEC * 1000 - usec) / 1000 + 1;
+		if (fdata->hidden_due_msec == 0 || due_msec < fdata->hidden_due_msec) {
+			fdata->hidden_due_msec = due_msec;
+		}
+		return;
+	}
+	node->last_frame_done = *fdata->when;
+	wlr_surface_send_frame_done(node->surface, fdata->when);
+}
+
+/* Surfaces under a snapshot aren't drawn, but their clients keep drawing
+ * until the snapshot is dropped, so they get their frame events as usual */
+static void send_frame_done_snapshot_iterator(struct spider_node *node,
+		void *data)
+{
+	struct frame_done_data *fdata = data;
+
+	if (!scene_node_on_output(node, fdata->output) ||
+			node->primary_output != fdata->output) {
+		return;
+	}
+	node->last_frame_done = *fdata->when;
+	wlr_surface_send_frame_done(node->surface, fdata->when);
+}
+
+static void output_send_frame_done(struct spider_output *output,
+		struct timespec *when, bool hidden_only)
+{
+	struct frame_done_data fdata = {
+		.output = output,
+		.when = when,
+		.hidden_only = hidden_only,
+	};
+	pixman_region32_init(&fdata.opaque);
+	scene_for_each_surface_reverse(output->compositor->scene,
+			send_frame_done_iterator, &fdata);
+	if (!hidden_only) {
+		scene_for_each_surface_under_snapshot(output->compositor->scene,
+				send_frame_done_snapshot_iterator, &fdata);
+	}
+	pixman_region32_fini(&fdata.opaque);
+
+	/* Zero disarms the timer when no hidden surface is waiting */
+	wl_event_source_timer_update(output->hidden_frame_timer,
+			fdata.hidden_due_msec);
+}
+
+static void send_frame_done(struct spider_output *output, struct timespec *when)
+{
+	output_send_frame_done(output, when, false);
+}
+
+/* Hidden surfaces on an output that isn't repainted still get their frame
+ * events, at the throttled rate */
+static int output_hidden_frame_timer(void *data)
+{
+	struct spider_output *output = data;
+
+	if (!output->wlr_output->enabled) {
+		return 0;
+	}
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	output_send_frame_done(output, &now, true);
+	return 0;
+}
+
+static void presentation_sampled_iterator(struct spider_node *node, void *data)
+{
+	struct spider_output *output = data;
+
+	if (node->primary_output != output) {
+		return;
+	}
+
+	wlr_presentation_surface_sampled(output->compositor->presentation,
+			node->surface);
+}
+
+/* Marks the current content of the surfaces on the output as part of the
+ * frame that was just committed, so that their presentation feedback is
+ * sent once that frame is actually shown. */
+static void output_presentation_sampled(struct spider_output *output)
+{
+	scene_for_each_surface(output->compositor->scene,
+			presentation_sampled_iterator, output);
+}
+
+struct presented_data {
+	struct spider_output *output;
+	struct wlr_presentation_event *event;
+};
+
+static void send_presented_iterator(struct spider_node *node, void *data)
+{
+	struct presented_data *pdata = data;
+
+	if (node->primary_output != pdata->output) {
+		return;
+	}
+
+	wlr_presentation_send_surface_presented(
+			pdata->output->compositor->presentation,
+			node->surface, pdata->event);
+}
+
+struct top_node_data {
+	struct spider_output *output;
+	struct wlr_box output_box;
+	struct spider_node *node;
+};
+
+static void top_node_iterator(struct spider_node *node, void *data)
+{
+	struct top_node_data *tdata = data;
+
+	if (tdata->node != NULL || !scene_node_on_output(node, tdata->output)) {
+		return;
+	}
+
+	struct wlr_box box, intersection;
+	output_node_box(tdata->output, node, &box);
+	if (wlr_box_intersection(&intersection, &tdata->output_box, &box)) {
+		tdata->node = node;
+	}
+}
+
+/* Returns the topmost surface node drawn on the output */
+static struct spider_node *output_top_node(struct spider_output *output)
+{
+	struct top_node_data tdata = {
+		.output = output,
+	};
+	wlr_output_transformed_resolution(output->wlr_output,
+			&tdata.output_box.width, &tdata.output_box.height);
+	scene_for_each_surface_reverse(output->compositor->scene,
+			top_node_iterator, &tdata);
+
+	return tdata.node;
+}
+
+static bool output_node_covers(struct spider_output *output,
+		struct spider_node *node)
+{
+	int width, height;
+	wlr_output_transformed_resolution(output->wlr_output, &width, &height);
+
+	struct wlr_box box;
+	output_node_box(output, node, &box);
+	return box.x == 0 && box.y == 0 &&
+		box.width == width && box.height == height;
+}
+
+/* Returns the view whose toplevel fills the whole output and is on top of
+ * it, or NULL when the desktop is showing. */
+static struct spider_view *output_fullscreen_view(struct spider_output *output)
+{
+	struct spider_node *node = output_top_node(output);
+	if (node == NULL || node->view == NULL) {
+		return NULL;
+	}
+
+	/* Popups and subsurfaces of the view may be above its toplevel */
+	struct spider_node *toplevel = wl_container_of(
+			node->view->node->children.next, toplevel, link);
+	if (!output_node_covers(output, toplevel)) {
+		return NULL;
+	}
+
+	return node->view;
+}
+
+/* Returns true if a cursor is shown on this output that didn't get a
+ * hardware cursor plane and has to be drawn into the frame instead. */
+static bool output_has_software_cursor(struct spider_output *output)
+{
+	struct wlr_output *wlr_output = output->wlr_output;
+	struct wlr_output_cursor *cursor;
+	spider_list_for_each(cursor, &wlr_output->cursors, link) {
+		if (cursor->enabled && cursor->visible &&
+				wlr_output->hardware_cursor != cursor) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void output_handle_mirror_scanout_failed_destroy(
+		struct wl_listener *listener, void *data)
+{
+	struct spider_output *output = wl_container_of(listener, output,
+			mirror_scanout_failed_destroy);
+	spider_list_remove(&output->mirror_scanout_failed_destroy.link);
+	output->mirror_scanout_failed = NULL;
+}
+
+/* The surface is forgotten when it is destroyed, so that a new surface at
+ * the same address can be scanned out again. */
+static void output_set_mirror_scanout_failed(struct spider_output *output,
+		struct wlr_surface *surface)
+{
+	if (output->mirror_scanout_failed == surface) {
+		return;
+	}
+	if (output->mirror_scanout_failed != NULL) {
+		spider_list_remove(&output->mirror_scanout_failed_destroy.link);
+	}
+
+	output->mirror_scanout_failed = surface;
+	if (surface != NULL) {
+		output->mirror_scanout_failed_destroy.notify =
+			output_handle_mirror_scanout_failed_destroy;
+		wl_signal_add(&surface->events.destroy,
+				&output->mirror_scanout_failed_destroy);
+	}
+}
+
+/* Mirrors show exactly what their source shows, so a buffer can only be
+ * scanned out if every mirror can scan it out as well. */
+static bool output_mirrors_can_scan_out(struct spider_output *output,
+		struct spider_node *node)
+{
+	struct wlr_output *wlr_output = output->wlr_output;
+
+	if (node->surface == output->mirror_scanout_failed) {
+		return false;
+	}
+	output_set_mirror_scanout_failed(output, NULL);
+
+	struct spider_output *mirror;
+	spider_list_for_each(mirror, &output->compositor->outputs, link) {
+		struct wlr_output *mirror_output = mirror->wlr_output;
+		if (!output_is_mirror_of(mirror, output)) {
+			continue;
+		}
+		if (mirror_output->width != wlr_output->width ||
+				mirror_output->height != wlr_output->height ||
+				mirror_output->transform != wlr_output->transform ||
+				mirror_output->scale != wlr_output->scale) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* Returns the surface node that alone fills the whole output and can be
+ * handed to the primary plane as is, or NULL if the output has to be
+ * composited. */
+static struct spider_node *output_scanout_node(struct spider_output *output)
+{
+	struct wlr_output *wlr_output = output->wlr_output;
+
+	/* A software cursor has to be drawn into the frame. */
+	if (output_has_software_cursor(output)) {
+		return NULL;
+	}
+
+	/* It can only be scanned out if it is a toplevel without any
+	 * subsurfaces or popups over it that fills the whole output with
+	 * opaque content. */
+	struct spider_node *node = output_top_node(output);
+	if (node == NULL || node->type != SPIDER_NODE_SURFACE ||
+			node->snapshot != NULL || !output_node_covers(output, node)) {
+		return NULL;
+	}
+
+	struct spider_node *child;
+	spider_list_for_each(child, &node->children, link) {
+		if (child->enabled) {
+			return NULL;
+		}
+	}
+	if (!surface_is_opaque(node->surface)) {
+		return NULL;
+	}
+	if (!output_mirrors_can_scan_out(output, node)) {
+		return NULL;
+	}
+
+	return node;
+}
+
+/* Returns true if a screencopy client asked for the next frame of this
+ * output. Captures are read back from the render buffer, so that frame has to
+ * be composited even if a client buffer could be scanned out. */
+static bool output_capture_pending(struct spider_output *output)
+{
+	struct wlr_screencopy_manager_v1 *screencopy =
+		output->compositor->screencopy;
+	if (screencopy == NULL) {
+		return false;
+	}
+
+	struct wlr_screencopy_frame_v1 *frame;
+	spider_list_for_each(frame, &screencopy->frames, link) {
+		if (frame->output == output->wlr_output &&
+				(frame->shm_buffer != NULL || frame->dma_buffer != NULL)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* Turns adaptive sync on while a fullscreen view is shown on an output that
+ * opted in, and back off for the desktop, whose animations and cursor look
+ * better at a fixed rate. With idle_refresh it is also on while the output
+ * is idle. Must be called right before committing a frame, with the
+ * rendered frame attached or before a client buffer is attached, so that a
+ * buffer the backend can't scan out isn't taken for missing support. */
+static void output_update_adaptive_sync(struct spider_output *output)
+{
+	struct wlr_output *wlr_output = output->wlr_output;
+
+	if ((output->config.adaptive_sync != 1 && output->config.idle_refresh != 1) ||
+			output->adaptive_sync_failed || !wlr_output_is_drm(wlr_output)) {
+		return;
+	}
+
+	/* At low refresh, the panel refreshes at its minimum rate while no new
+	 * frames arrive, without a modeset */
+	struct spider_view *view = NULL;
+	if (output->config.adaptive_sync == 1) {
+		view = output_fullscreen_view(output);
+	}
+	bool enable = view != NULL || output->refresh_low;
+	bool enabled = wlr_output->adaptive_sync_status !=
+		WLR_OUTPUT_ADAPTIVE_SYNC_DISABLED;
+	if (enable == enabled) {
+		return;
+	}
+
+	wlr_output_enable_adaptive_sync(wlr_output, enable);
+	if (!wlr_output_test(wlr_output)) {
+		/* Take back the request but keep a frame that is attached */
+		wlr_output_enable_adaptive_sync(wlr_output, enabled);
+		spider_err("Adaptive sync is not supported by %s\n", wlr_output->name);
+		output->adaptive_sync_failed = true;
+		return;
+	}
+
+	if (view != NULL) {
+		spider_dbg("Enable adaptive sync on %s for %s\n", wlr_output->name,
+				view->xdg_surface->toplevel->title);
+	}else if (enable) {
+		spider_dbg("Enable adaptive sync on %s while idle\n", wlr_output->name);
+	}else {
+		spider_dbg("Disable adaptive sync on %s\n", wlr_output->name);
+	}
+}
+
+static bool output_scan_out(struct spider_output *output,
+		struct spider_node *node)
+{
+	struct wlr_output *wlr_output = output->wlr_output;
+	struct wlr_surface *surface = node->surface;
+
+	if (surface->buffer == NULL) {
+		return false;
+	}
+	/* wl_shm buffers can't go on a plane. Don't lock them by attaching, so
+	 * that their texture keeps taking partial updates. */
+	if (surface->buffer->resource == NULL ||
+			wl_shm_buffer_get(surface->buffer->resource) != NULL) {
+		return false;
+	}
+	/* A buffer that is cropped or scaled by a viewport can't be shown as
+	 * is, even if its size matches the mode */
+	if (viewport_is_set(surface) ||
+			surface->current.buffer_width != wlr_output->width ||
+			surface->current.buffer_height != wlr_output->height) {
+		return false;
+	}
+	if ((float)surface->current.scale != wlr_output->scale ||
+			surface->current.transform != wlr_output->transform) {
+		return false;
+	}
+
+	output_update_adaptive_sync(output);
+	wlr_output_attach_buffer(wlr_output, &surface->buffer->base);
+	if (!wlr_output_test(wlr_output)) {
+		/* The backend can't put this buffer on the primary plane, e.g.
+		 * because of its format or modifier. */
+		wlr_output_rollback(wlr_output);
+		return false;
+	}
+
+	return wlr_output_commit(wlr_output);
+}
+
+/* Keeps the last render durations and, in auto mode, derives the render
+ * budget from the slowest of them plus some headroom. */
+static void output_record_render_time(struct spider_output *output,
+		const struct timespec *start)
+{
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	output->render_time_usec[output->render_time_idx] =
+		timespec_to_usec(start, &end);
+	output->render_time_idx =
+		(output->render_time_idx + 1) % RENDER_TIME_SAMPLES;
+
+	if (output->config.max_render_time != MAX_RENDER_TIME_AUTO) {
+		return;
+	}
+
+	int max_usec = 0;
+	for (int i = 0; i < RENDER_TIME_SAMPLES; i++) {
+		if (output->render_time_usec[i] > max_usec) {
+			max_usec = output->render_time_usec[i];
+		}
+	}
+
+	int budget = (max_usec + RENDER_TIME_HEADROOM_USEC + 999) / 1000;
+	int refresh_msec = output->refresh_nsec / 1000000;
+	if (refresh_msec > 1 && budget > refresh_msec - 1) {
+		budget = refresh_msec - 1;
+	}
+	if (budget < 1) {
+		budget = 1;
+	}
+
+	if (budget != output->max_render_time) {
+		spider_verbose("max render time of %s is now %d ms\n",
+				output->wlr_output->name, budget);
+		output->max_render_time = budget;
+	}
+}
+
+static uint64_t timespec_diff_usec(const struct timespec *a,
+		const struct timespec *b)
+{
+	return (uint64_t)(b->tv_sec - a->tv_sec) * 1000000 +
+		(b->tv_nsec - a->tv_nsec) / 1000;
+}
+
+/* Switches between full and low refresh. Adaptive sync is changed with the
+ * next commit, which for a low refresh has to be forced since nothing is
+ * being drawn. */
+static void output_set_refresh_low(struct spider_output *output, bool low)
+{
+	if (output->refresh_low == low) {
+		return;
+	}
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (low) {
+		output->stats.refresh_low_switches++;
+		output->stats.refresh_low_start = now;
+	}else {
+		output->stats.refresh_low_usec +=
+			timespec_diff_usec(&output->stats.refresh_low_start, &now);
+	}
+
+	spider_dbg("%s refresh on %s\n", low ? "Low" : "Full",
+			output->wlr_output->name);
+	output->refresh_low = low;
+	output->refresh_window_start = now;
+	output->refresh_window_frames = 0;
+
+	if (output->damage != NULL) {
+		struct wlr_box box = {
+			.width = 1,
+			.height = 1,
+		};
+		wlr_output_damage_add_box(output->damage, &box);
+	}
+	if (!low) {
+		wl_event_source_timer_update(output->refresh_timer,
+				REFRESH_WINDOW_MSEC);
+	}
+}
+
+/* Runs at full refresh only. An output that drew next to nothing for a
+ * whole window goes to low refresh and needs no timer until it draws
+ * again. */
+static int output_refresh_timer(void *data)
+{
+	struct spider_output *output = data;
+
+	if (output->refresh_window_frames <= REFRESH_IDLE_FRAMES) {
+		output_set_refresh_low(output, true);
+		return 0;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &output->refresh_window_start);
+	output->refresh_window_frames = 0;
+	wl_event_source_timer_update(output->refresh_timer, REFRESH_WINDOW_MSEC);
+	return 0;
+}
+
+/* At low refresh, a burst of frames such as an animation goes back to full
+ * refresh right away. */
+static void output_refresh_frame(struct spider_output *output,
+		const struct timespec *when)
+{
+	if (output->config.idle_refresh != 1) {
+		return;
+	}
+
+	if (output->refresh_low && timespec_diff_usec(
+				&output->refresh_window_start, when) >=
+			REFRESH_WINDOW_MSEC * 1000) {
+		output->refresh_window_start = *when;
+		output->refresh_window_frames = 0;
+	}
+	output->refresh_window_frames++;
+
+	if (output->refresh_low &&
+			output->refresh_window_frames > REFRESH_IDLE_FRAMES) {
+		output_set_refresh_low(output, false);
+	}
+}
+
+/* Input is followed by frames. Go to full refresh before they are drawn. */
+void output_notify_activity(struct spider_output *output)
+{
+	if (output->config.idle_refresh == 1) {
+		output_set_refresh_low(output, false);
+	}
+}
+
+static void output_record_commit(struct spider_output *output)
+{
+	clock_gettime(CLOCK_MONOTONIC, &output->stats.commit);
+	histogram_add(&output->stats.frame_to_commit,
+			timespec_to_usec(&output->stats.frame_event, &output->stats.commit));
+	output->stats.presentation_pending = true;
+	output->stats.frames++;
+	output_refresh_frame(output, &output->stats.commit);
+}
+
+/* Returns how many milliseconds the repaint can still wait for so that it
+ * finishes right before the predicted vblank. */
+static int output_repaint_delay(struct spider_output *output)
+{
+	if (output->max_render_time == MAX_RENDER_TIME_OFF ||
+			output->refresh_nsec == 0) {
+		return 0;
+	}
+
+	struct timespec predicted_refresh = output->last_presentation;
+	predicted_refresh.tv_nsec += output->refresh_nsec % 1000000000;
+	predicted_refresh.tv_sec += output->refresh_nsec / 1000000000;
+	if (predicted_refresh.tv_nsec >= 1000000000) {
+		predicted_refresh.tv_sec += 1;
+		predicted_refresh.tv_nsec -= 1000000000;
+	}
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	/* If the predicted refresh is already behind us, the output has been idle
+	 * and there is nothing to wait for. */
+	int64_t usec_until_refresh = timespec_to_usec(&now, &predicted_refresh);
+	if (usec_until_refresh <= 0) {
+		return 0;
+	}
+	/* Never wait longer than a refresh, whatever the timestamps say */
+	if (usec_until_refresh > output->refresh_nsec / 1000) {
+		usec_until_refresh = output->refresh_nsec / 1000;
+	}
+
+	return usec_until_refresh / 1000 - output->max_render_time;
+}
+
+/* Tells the backend which part of the buffer changed, in buffer
+ * coordinates */
+static void output_set_frame_damage(struct spider_output *output)
+{
+	struct wlr_output *wlr_output = output->wlr_output;
+
+	int width, height;
+	wlr_output_transformed_resolution(wlr_output, &width, &height);
+
+	pixman_region32_t frame_damage;
+	pixman_region32_init(&frame_damage);
+
+	enum wl_output_transform transform =
+		wlr_output_transform_invert(wlr_output->transform);
+	wlr_region_transform(&frame_damage, &output->damage->current,
+			transform, width, height);
+
+	wlr_output_set_damage(wlr_output, &frame_damage);
+	pixman_region32_fini(&frame_damage);
+}
+
+/* Mirrors have no surfaces of their own. While the source scans out a
+ * client buffer they scan it out too, otherwise they copy the source's
+ * composited frame where it changed. */
+static void output_repaint_mirror(struct spider_output *output)
+{
+	struct wlr_output *wlr_output = output->wlr_output;
+	struct wlr_renderer *renderer = output->compositor->renderer;
+	struct spider_output *source = output_mirror_source(output);
+
+	if (source != NULL && source->scanned_out) {
+		/* Already showing the source's buffer */
+		if (output->scanned_out &&
+				output->mirror_scanout_seq == source->scanout_seq) {
+			return;
+		}
+
+		struct spider_node *node = output_scanout_node(source);
+		if (node != NULL && output_scan_out(output, node)) {
+			output_record_commit(output);
+			output->scanned_out = true;
+			output->mirror_scanout_seq = source->scanout_seq;
+			return;
+		}
+
+		/* Have the source composite again, its next frame damages this
+		 * output */
+		if (node != NULL) {
+			spider_dbg("%s can't scan out the buffer %s does\n",
+					wlr_output->name, source->wlr_output->name);
+			output_set_mirror_scanout_failed(source, node->surface);
+		}
+		output_damage_whole(source);
+		return;
+	}
+
+	if (output->scanned_out) {
+		output->scanned_out = false;
+		output_damage_whole(output);
+	}
+
+	bool needs_frame;
+	pixman_region32_t damage;
+	pixman_region32_init(&damage);
+	if (!wlr_output_damage_attach_render(output->damage, &needs_frame, &damage)) {
+		goto damage_finish;
+	}
+	if (!needs_frame) {
+		wlr_output_rollback(wlr_output);
+		goto damage_finish;
+	}
+
+	wlr_renderer_begin(renderer, wlr_output->width, wlr_output->height);
+	if (source != NULL && g_options.pixman && source->shadow_texture != NULL) {
+		output_render_shadow(output, source->shadow_texture, &damage);
+	}else if (source != NULL && !g_options.pixman &&
+			source->frame.texture != NULL) {
+		output_render_buffer(output, source->frame.texture,
+				source->wlr_output->transform, &damage);
+	}else {
+		output_clear(output, &damage);
+	}
+	wlr_renderer_scissor(renderer, NULL);
+	wlr_renderer_end(renderer);
+
+	output_set_frame_damage(output);
+	if (wlr_output_commit(wlr_output)) {
+		output_record_commit(output);
+	}
+
+damage_finish:
+	pixman_region32_fini(&damage);
+}
+
+static void output_repaint(struct spider_output *output)
+{
+	struct wlr_output *wlr_output = output->wlr_output;
+	struct wlr_renderer *renderer = output->compositor->renderer;
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	if (output->config.mirror != NULL) {
+		output_repaint_mirror(output);
+		return;
+	}
+
+	/* This func may print too much logs */
+	// spider_dbg("Frame %s\n", wlr_output->name);
+
+	bool needs_frame;
+	pixman_region32_t damage;
+	pixman_region32_init(&damage);
+
+	struct spider_node *scanout_node = NULL;
+	if (!output_capture_pending(output)) {
+		scanout_node = output_scanout_node(output);
+	}
+	if (scanout_node != NULL) {
+		needs_frame = wlr_output->needs_frame ||
+			pixman_region32_not_empty(&output->damage->current);
+		if (!needs_frame) {
+			goto frame_done;
+		}
+
+		if (output_scan_out(output, scanout_node)) {
+			output_record_render_time(output, &now);
+			output_record_commit(output);
+			output_presentation_sampled(output);
+			if (!output->scanned_out) {
+				spider_dbg("Scanning out %s on %s\n",
+						scanout_node->view->xdg_surface->toplevel->title,
+						wlr_output->name);
+			}
+			output->scanned_out = true;
+			output->scanout_seq++;
+			output_schedule_mirrors(output);
+			goto frame_done;
+		}
+	}
+
+	if (output->scanned_out) {
+		/* The render buffers are stale after scanning out client buffers. */
+		spider_dbg("Stop scanning out on %s\n", wlr_output->name);
+		output->scanned_out = false;
+		output_damage_whole(output);
+	}
+
+	if (!wlr_output_damage_attach_render(output->damage, &needs_frame, &damage)) {
+		goto damage_finish;
+	}
+
+	if (!needs_frame) {
+		/* Nothing changed on this output. Skip the repaint, but still let
+		 * clients know they may draw their next frame. */
+		wlr_output_rollback(wlr_output);
+		goto frame_done;
+	}
+
+	struct timespec render_start, render_end;
+	clock_gettime(CLOCK_MONOTONIC, &render_start);
+	wlr_renderer_begin(renderer, wlr_output->width, wlr_output->height);
+
+	if (!pixman_region32_not_empty(&damage)) {
+		goto renderer_end;
+	}
+
+	if (g_options.pixman) {
+		output_render_scene_pixman(output, &damage);
+	}else if (output_has_mirrors(output)) {
+		output_render_scene_mirrored(output, &damage, &now);
+	}else {
+		if (output->frame.texture != NULL) {
+			/* The last mirror went away */
+			offscreen_finish(&output->frame, renderer);
+		}
+		output_render_scene(output, &damage, &now);
+	}
+
+renderer_end:
+	/* Cursor moves only damage the old and new cursor boxes, and nothing at
+	 * all if the cursor is on a hardware plane. */
+	if (output_has_software_cursor(output)) {
+		wlr_output_render_software_cursors(wlr_output, &damage);
+	}
+	wlr_renderer_scissor(renderer, NULL);
+	wlr_renderer_end(renderer);
+	clock_gettime(CLOCK_MONOTONIC, &render_end);
+	histogram_add(&output->stats.render,
+			timespec_to_usec(&render_start, &render_end));
+
+	output_set_frame_damage(output);
+	output_update_adaptive_sync(output);
+
+	if (!wlr_output_commit(wlr_output)) {
+		goto damage_finish;
+	}
+	output_record_render_time(output, &now);
+	output_record_commit(output);
+	output_presentation_sampled(output);
+
+frame_done:
+	send_frame_done(output, &now);
+
+damage_finish:
+	pixman_region32_fini(&damage);
+}
+
+static int output_repaint_timer(void *data)
 {
-	struct render_data *rdata = data;
-	struct spider_view *view = rdata->view;
-	struct wlr_output *output = rdata->output;
+	struct spider_output *output = data;
 
-	struct wlr_texture *texture = wlr_surface_get_texture(surface);
-	if (texture == NULL) {
+	output->wlr_output->frame_pending = false;
+	/* The output may have been powered down while the repaint was delayed */
+	if (!output->wlr_output->enabled) {
+		return 0;
+	}
+	output_repaint(output);
+	return 0;
+}
+
+/* This function is called every time an output is ready to display a frame,
+ * generally at the output's refresh rate (e.g. 60Hz). The damage tracker only
+ * fires it after something was damaged or a client asked for a frame. */
+static void output_damage_handle_frame(struct wl_listener *listener, void *data)
+{
+	struct spider_output *output =
+		wl_container_of(listener, output, damage_frame);
+
+	if (!output->wlr_output->enabled) {
 		return;
 	}
+	clock_gettime(CLOCK_MONOTONIC, &output->stats.frame_event);
 
-	double ox = 0, oy = 0;
-	wlr_output_layout_output_coords(
-			view->compositor->output_layout, output, &ox, &oy);
-	ox += view->box.x + sx, oy += view->box.y + sy;
+	/* Rendering as soon as the frame event fires makes the frame wait for
+	 * almost a whole refresh before it is shown. Instead, start it late
+	 * enough that it is finished just in time for the next vblank. */
+	int delay = output_repaint_delay(output);
+	if (delay < 1) {
+		output_repaint(output);
+		return;
+	}
 
-	struct wlr_box box = {
-		.x = ox * output->scale,
-		.y = oy * output->scale,
-		.width = surface->current.width * output->scale,
-		.height = surface->current.height * output->scale,
-	};
+	/* Keep wlroots from sending another frame event meanwhile */
+	output->wlr_output->frame_pending = true;
+	wl_event_source_timer_update(output->repaint_timer, delay);
+}
 
-	/*
-	spider_dbg("box x=%d y=%d width=%d height=%d\n", 
-			box.x, box.y, box.width, box.height);
-	*/
+static void output_damage_handle_destroy(struct wl_listener *listener, void *data)
+{
+	struct spider_output *output =
+		wl_container_of(listener, output, damage_destroy);
 
-	float matrix[9];
-	enum wl_output_transform transform =
-		wlr_output_transform_invert(surface->current.transform);
-	wlr_matrix_project_box(matrix, &box, transform, 0,
-			output->transform_matrix);
+	spider_list_remove(&output->damage_frame.link);
+	spider_list_remove(&output->damage_destroy.link);
+	output->damage = NULL;
+}
+
+static void output_handle_destroy(struct wl_listener *listener, void *data)
+{
+	struct spider_output *output = wl_container_of(listener, output, destroy);
+	spider_dbg("Terminate %s\n", output->wlr_output->name);
+
+	spider_list_remove(&output->link);
+	scene_update_outputs(output->compositor->scene);
 
-	wlr_render_texture_with_matrix(rdata->renderer, texture, matrix, 1);
+	/* Its mirrors go black */
+	struct spider_output *mirror;
+	spider_list_for_each(mirror, &output->compositor->outputs, link) {
+		if (output_is_mirror_of(mirror, output)) {
+			output_damage_whole(mirror);
+		}
+	}
+	spider_list_remove(&output->destroy.link);
+	spider_list_remove(&output->enable.link);
+	spider_list_remove(&output->mode.link);
+	spider_list_remove(&output->transform.link);
+	spider_list_remove(&output->present.link);
+	output_set_mirror_scanout_failed(output, NULL);
 
-	wlr_surface_send_frame_done(surface, rdata->when);
+	wl_event_source_remove(output->repaint_timer);
+	wl_event_source_remove(output->hidden_frame_timer);
+	if (output->refresh_timer != NULL) {
+		wl_event_source_remove(output->refresh_timer);
+	}
+	pixman_render_output_finish(output);
+	offscreen_finish(&output->layer_cache, output->compositor->renderer);
+	offscreen_finish(&output->frame, output->compositor->renderer);
+	pixman_region32_fini(&output->layer_cache_dirty);
+	output->wlr_output->data = NULL;
+	free(output);
 }
 
-/* This function is called every time an output is ready to display a frame,
- * generally at the output's refresh rate (e.g. 60Hz). */
-static void output_handle_frame(struct wl_listener *listener, void *data)
+void output_damage_whole(struct spider_output *output)
 {
-	struct spider_output *output = wl_container_of(listener, output, frame);
-	struct wlr_renderer *renderer = output->compositor->renderer;
+	if (output->damage == NULL) {
+		return;
+	}
 
-	struct timespec now;
-	clock_gettime(CLOCK_MONOTONIC, &now);
+	wlr_output_damage_add_whole(output->damage);
+	/* A new transform or scale changes how the cache is drawn as well */
+	if (output->layer_cache.texture != NULL) {
+		int width, height;
+		wlr_output_transformed_resolution(output->wlr_output, &width, &height);
+		pixman_region32_union_rect(&output->layer_cache_dirty,
+				&output->layer_cache_dirty, 0, 0, width, height);
+	}
+}
 
-	/* This func may print too much logs */
-	// spider_dbg("Frame %s\n", output->wlr_output->name);
+void output_damage_box(struct spider_output *output, struct wlr_box *box)
+{
+	struct wlr_output *wlr_output = output->wlr_output;
+
+	/* Mirrors aren't part of the layout */
+	if (output->damage == NULL || output->config.mirror != NULL) {
+		return;
+	}
+
+	struct wlr_box damage_box;
+	output_layout_box(output, box->x, box->y, box->width, box->height,
+			&damage_box);
+	wlr_output_damage_add_box(output->damage, &damage_box);
+}
 
-	if (!wlr_output_attach_render(output->wlr_output, NULL)) {
+/* Marks a box in layout coordinates as out of date in the layer cache */
+void output_damage_layer_cache(struct spider_output *output, struct wlr_box *box)
+{
+	if (output->layer_cache.texture == NULL) {
+		/* It is drawn as a whole once it exists */
 		return;
 	}
 
 	int width, height;
-	wlr_output_effective_resolution(output->wlr_output, &width, &height);
-	wlr_renderer_begin(renderer, width, height);
+	wlr_output_transformed_resolution(output->wlr_output, &width, &height);
 
-	float color[4] = {0.0, 0.0, 0.0, 1.0};
-	wlr_renderer_clear(renderer, color);
+	struct wlr_box damage_box;
+	output_layout_box(output, box->x, box->y, box->width, box->height,
+			&damage_box);
+	pixman_region32_union_rect(&output->layer_cache_dirty,
+			&output->layer_cache_dirty, damage_box.x, damage_box.y,
+			damage_box.width, damage_box.height);
+	pixman_region32_intersect_rect(&output->layer_cache_dirty,
+			&output->layer_cache_dirty, 0, 0, width, height);
+}
 
+void output_damage_surface(struct spider_output *output,
+		struct wlr_surface *surface, double lx, double ly, bool whole,
+		bool cached)
+{
+	struct wlr_output *wlr_output = output->wlr_output;
 
-	struct spider_view *view;
-	spider_list_for_each_reverse(view, &output->compositor->views, link) {
-		if (!view->mapped) {
-			continue;
-		}
-		struct render_data rdata = {
-			.output = output->wlr_output,
-			.view = view,
-			.renderer = renderer,
-			.when = &now,
-		};
-		wlr_xdg_surface_for_each_surface(view->xdg_surface,
-				render_surface, &rdata);
+	if (output->damage == NULL || output->config.mirror != NULL) {
+		return;
 	}
 
-	wlr_output_render_software_cursors(output->wlr_output, NULL);
+	int width, height;
+	viewport_surface_size(surface, &width, &height);
+
+	struct wlr_box box;
+	output_layout_box(output, lx, ly, width, height, &box);
 
-	wlr_renderer_end(renderer);
-	wlr_output_commit(output->wlr_output);
+	struct wlr_box output_box = {
+		.width = wlr_output->width,
+		.height = wlr_output->height,
+	};
+	struct wlr_box intersection;
+	if (!wlr_box_intersection(&intersection, &output_box, &box)) {
+		return;
+	}
+
+	if (whole) {
+		wlr_output_damage_add_box(output->damage, &box);
+		if (cached && output->layer_cache.texture != NULL) {
+			pixman_region32_union_rect(&output->layer_cache_dirty,
+					&output->layer_cache_dirty, box.x, box.y,
+					box.width, box.height);
+		}
+	} else {
+		pixman_region32_t damage;
+		pixman_region32_init(&damage);
+		wlr_surface_get_effective_damage(surface, &damage);
+		viewport_apply_damage(surface, &damage);
+		wlr_region_scale(&damage, &damage, wlr_output->scale);
+		if (ceil(wlr_output->scale) > surface->current.scale) {
+			/* When scaling up a surface, it'll become blurry so we need to
+			 * expand the damage region */
+			wlr_region_expand(&damage, &damage,
+					ceil(wlr_output->scale) - surface->current.scale);
+		}
+		pixman_region32_translate(&damage, box.x, box.y);
+		wlr_output_damage_add(output->damage, &damage);
+		if (cached && output->layer_cache.texture != NULL) {
+			pixman_region32_union(&output->layer_cache_dirty,
+					&output->layer_cache_dirty, &damage);
+		}
+		pixman_region32_fini(&damage);
+	}
+
+	/* Clients waiting on a frame callback need a frame event even when their
+	 * commit carried no damage. */
+	wlr_output_schedule_frame(wlr_output);
 }
 
-static void output_handle_destroy(struct wl_listener *listener, void *data)
+/* A powered down output gets no frame events, so nothing is rendered for it
+ * and the surfaces on it aren't asked to draw either. */
+bool output_set_power(struct spider_output *output, bool on)
 {
-	struct spider_output *output = wl_container_of(listener, output, destroy);
-	spider_dbg("Terminate %s\n", output->wlr_output->name);
+	struct wlr_output *wlr_output = output->wlr_output;
+
+	if (wlr_output->enabled == on) {
+		return true;
+	}
+
+	wlr_output_enable(wlr_output, on);
+	if (!wlr_output_commit(wlr_output)) {
+		spider_err("Failed to power %s %s\n", on ? "on" : "off",
+				wlr_output->name);
+		return false;
+	}
+
+	if (on) {
+		output_damage_whole(output);
+	}
+	return true;
 }
 
 static void output_handle_enable(struct wl_listener *listener, void *data)
 {
-	struct spider_output *output = wl_container_of(listener, output, destroy);
+	struct spider_output *output = wl_container_of(listener, output, enable);
 	spider_dbg("Enable %s\n", output->wlr_output->name);
 }
 
 static void output_handle_mode(struct wl_listener *listener, void *data)
 {
-	struct spider_output *output = wl_container_of(listener, output, destroy);
+	struct spider_output *output = wl_container_of(listener, output, mode);
 	spider_dbg("Mode %s\n", output->wlr_output->name);
+	output_damage_whole(output);
 }
 
 static void output_handle_transform(struct wl_listener *listener, void *data)
 {
-	struct spider_output *output = wl_container_of(listener, output, destroy);
+	struct spider_output *output = wl_container_of(listener, output, transform);
 	spider_dbg("Transform %s\n", output->wlr_output->name);
+	output_damage_whole(output);
+}
+
+/* Logs how many frames per second actually reached the screen, which with
+ * adaptive sync is what the panel is refreshing at. */
+static void output_report_refresh(struct spider_output *output,
+		const struct timespec *when)
+{
+	struct wlr_output *wlr_output = output->wlr_output;
+
+	/* The first presentation only starts the interval; measuring from zero
+	 * would overflow */
+	if (output->refresh_report_start.tv_sec == 0) {
+		output->refresh_report_start = *when;
+		output->refresh_report_frames = 0;
+		return;
+	}
+
+	output->refresh_report_frames++;
+	int usec = timespec_to_usec(&output->refresh_report_start, when);
+	if (usec < 1000000) {
+		return;
+	}
+
+	int mhz = (int64_t)output->refresh_report_frames * 1000000000 / usec;
+	spider_verbose("%s refreshes at %d.%03d Hz, adaptive sync %s\n",
+			wlr_output->name, mhz / 1000, mhz % 1000,
+			wlr_output->adaptive_sync_status ==
+			WLR_OUTPUT_ADAPTIVE_SYNC_ENABLED ? "on" : "off");
+
+	output->refresh_report_start = *when;
+	output->refresh_report_frames = 0;
 }
 
 static void output_handle_present(struct wl_listener *listener, void *data) 
 {
-	struct spider_output *output = wl_container_of(listener, output, destroy);
+	struct spider_output *output = wl_container_of(listener, output, present);
 
 	struct wlr_output_event_present *output_event = data;
 
+	/* The frame scheduler predicts the next vblank from the last one */
+	output->last_presentation = *output_event->when;
+	output->refresh_nsec = output_event->refresh;
+
+	output_report_refresh(output, output_event->when);
+
+	if (output->stats.presentation_pending) {
+		int usec = timespec_to_usec(&output->stats.commit, output_event->when);
+		histogram_add(&output->stats.commit_to_present, usec);
+		/* A frame committed in time is shown at the next vblank */
+		if (output_event->refresh > 0) {
+			output->stats.missed_vblanks +=
+				(int64_t)usec * 1000 / output_event->refresh;
+		}
+		output->stats.presentation_pending = false;
+	}
+
 	struct wlr_presentation_event event = {
 		.output = output->wlr_output,
 		.tv_sec = (uint64_t)output_event->when->tv_sec,
@@ -157,6 +1738,306 @@ static void output_handle_present(struct wl_listener *listener, void *data)
 			output->wlr_output->name, event.tv_sec, event.tv_nsec,
 			event.refresh, event.seq, event.flags);
 	*/
+
+	struct presented_data pdata = {
+		.output = output,
+		.event = &event,
+	};
+	scene_for_each_surface(output->compositor->scene,
+			send_presented_iterator, &pdata);
+}
+
+void output_dump_stats(struct spider_output *output, FILE *f)
+{
+	fprintf(f, "%s: %u frames, %u missed vblanks, max render time %d ms\n",
+			output->wlr_output->name, output->stats.frames,
+			output->stats.missed_vblanks, output->max_render_time);
+	histogram_dump(&output->stats.frame_to_commit, "frame to commit", f);
+	histogram_dump(&output->stats.render, "render", f);
+	histogram_dump(&output->stats.commit_to_present, "commit to present", f);
+	if (output->config.idle_refresh == 1) {
+		uint64_t low_usec = output->stats.refresh_low_usec;
+		if (output->refresh_low) {
+			struct timespec now;
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			low_usec += timespec_diff_usec(
+					&output->stats.refresh_low_start, &now);
+		}
+		fprintf(f, "%s: %u switches to low refresh, %"PRIu64" ms at low "
+				"refresh%s\n", output->wlr_output->name,
+				output->stats.refresh_low_switches, low_usec / 1000,
+				output->refresh_low ? " (now)" : "");
+	}
+}
+
+void output_reset_stats(struct spider_output *output)
+{
+	output->stats.frames = 0;
+	output->stats.missed_vblanks = 0;
+	histogram_reset(&output->stats.frame_to_commit);
+	histogram_reset(&output->stats.render);
+	histogram_reset(&output->stats.commit_to_present);
+	output->stats.refresh_low_switches = 0;
+	output->stats.refresh_low_usec = 0;
+	clock_gettime(CLOCK_MONOTONIC, &output->stats.refresh_low_start);
+}
+
+/* Picks the configured mode if the output has it. Otherwise the preferred
+ * mode's resolution is taken as native (the largest one if no mode is
+ * preferred) and the highest refresh rate at that resolution wins, so that a
+ * monitor advertising several rates doesn't end up at the slowest one. */
+static struct wlr_output_mode *output_pick_mode(struct spider_output *output)
+{
+	struct wlr_output *wlr_output = output->wlr_output;
+	struct spider_output_config *config = &output->config;
+	struct wlr_output_mode *mode, *best = NULL;
+
+	if (config->mode_width != OUTPUT_CONFIG_UNSET) {
+		spider_list_for_each(mode, &wlr_output->modes, link) {
+			if (mode->width != config->mode_width ||
+					mode->height != config->mode_height) {
+				continue;
+			}
+			if (best == NULL) {
+				best = mode;
+			}else if (config->mode_refresh > 0) {
+				if (abs(mode->refresh - config->mode_refresh) <
+						abs(best->refresh - config->mode_refresh)) {
+					best = mode;
+				}
+			}else if (mode->refresh > best->refresh) {
+				best = mode;
+			}
+		}
+		if (best != NULL) {
+			return best;
+		}
+		spider_err("%s has no %dx%d mode, picking one\n", wlr_output->name,
+				config->mode_width, config->mode_height);
+	}
+
+	struct wlr_output_mode *native = NULL;
+	spider_list_for_each(mode, &wlr_output->modes, link) {
+		if (mode->preferred) {
+			native = mode;
+			break;
+		}
+		if (native == NULL || mode->width * mode->height >
+				native->width * native->height) {
+			native = mode;
+		}
+	}
+
+	best = native;
+	spider_list_for_each(mode, &wlr_output->modes, link) {
+		if (mode->width == native->width && mode->height == native->height &&
+				mode->refresh > best->refresh) {
+			best = mode;
+		}
+	}
+
+	return best;
+}
+
+static bool output_try_mode(struct spider_output *output,
+		struct wlr_output_mode *mode)
+{
+	struct wlr_output *wlr_output = output->wlr_output;
+
+	spider_dbg("%s: try %"PRId32"x%"PRId32"@%"PRId32"mHz\n", wlr_output->name,
+			mode->width, mode->height, mode->refresh);
+	wlr_output_set_mode(wlr_output, mode);
+	wlr_output_enable(wlr_output, true);
+	if (!wlr_output_commit(wlr_output)) {
+		spider_err("%s: can't set %"PRId32"x%"PRId32"@%"PRId32"mHz\n",
+				wlr_output->name, mode->width, mode->height, mode->refresh);
+		return false;
+	}
+
+	return true;
+}
+
+static void output_set_initial_mode(struct spider_output *output)
+{
+	struct wlr_output *wlr_output = output->wlr_output;
+	struct wlr_output_mode *picked = output_pick_mode(output);
+	if (output_try_mode(output, picked)) {
+		return;
+	}
+
+	/* The link may not carry the fastest mode, walk down the list until one
+	 * of them works */
+	struct wlr_output_mode *mode;
+	spider_list_for_each(mode, &wlr_output->modes, link) {
+		if (mode != picked && output_try_mode(output, mode)) {
+			return;
+		}
+	}
+	spider_err("No usable mode on %s\n", wlr_output->name);
+}
+
+/* Tells output management clients (e.g. wlr-randr) about the current
+ * state of every output. */
+static void output_manager_update(struct spider_compositor *compositor)
+{
+	if (compositor->output_manager == NULL) {
+		return;
+	}
+
+	struct wlr_output_configuration_v1 *config =
+		wlr_output_configuration_v1_create();
+	if (config == NULL) {
+		return;
+	}
+
+	struct spider_output *output;
+	spider_list_for_each(output, &compositor->outputs, link) {
+		struct wlr_output_configuration_head_v1 *head =
+			wlr_output_configuration_head_v1_create(config, output->wlr_output);
+		if (head == NULL) {
+			continue;
+		}
+		head->state.x = output->lx;
+		head->state.y = output->ly;
+	}
+
+	wlr_output_manager_v1_set_configuration(compositor->output_manager, config);
+}
+
+static bool output_apply_head(struct spider_compositor *compositor,
+		struct wlr_output_configuration_head_v1 *head, bool test_only)
+{
+	struct wlr_output *wlr_output = head->state.output;
+
+	wlr_output_enable(wlr_output, head->state.enabled);
+	if (head->state.enabled) {
+		if (head->state.mode != NULL) {
+			wlr_output_set_mode(wlr_output, head->state.mode);
+		}else {
+			wlr_output_set_custom_mode(wlr_output,
+					head->state.custom_mode.width,
+					head->state.custom_mode.height,
+					head->state.custom_mode.refresh);
+		}
+		wlr_output_set_transform(wlr_output, head->state.transform);
+		wlr_output_set_scale(wlr_output, head->state.scale);
+	}
+
+	if (test_only) {
+		bool ok = wlr_output_test(wlr_output);
+		wlr_output_rollback(wlr_output);
+		return ok;
+	}
+
+	if (!wlr_output_commit(wlr_output)) {
+		return false;
+	}
+
+	/* Mirrors stay out of the layout, they only show their source */
+	struct spider_output *output = wlr_output->data;
+	if (output != NULL && output->config.mirror != NULL) {
+		output_damage_mirror(output);
+		return true;
+	}
+
+	/* The layout change that follows damages the output and re-sends the
+	 * configuration */
+	if (head->state.enabled) {
+		wlr_output_layout_add(compositor->output_layout, wlr_output,
+				head->state.x, head->state.y);
+	}else {
+		wlr_output_layout_remove(compositor->output_layout, wlr_output);
+	}
+
+	return true;
+}
+
+static void output_manager_apply(struct spider_compositor *compositor,
+		struct wlr_output_configuration_v1 *config, bool test_only)
+{
+	bool ok = true;
+	struct wlr_output_configuration_head_v1 *head;
+	spider_list_for_each(head, &config->heads, link) {
+		if (!output_apply_head(compositor, head, test_only)) {
+			spider_err("%s configuration of %s failed\n",
+					test_only ? "Test" : "Apply", head->state.output->name);
+			ok = false;
+			break;
+		}
+	}
+
+	if (ok) {
+		wlr_output_configuration_v1_send_succeeded(config);
+	}else {
+		wlr_output_configuration_v1_send_failed(config);
+	}
+	wlr_output_configuration_v1_destroy(config);
+
+	if (!test_only) {
+		output_manager_update(compositor);
+	}
+}
+
+void handle_output_manager_apply(struct wl_listener *listener, void *data)
+{
+	struct spider_compositor *compositor =
+		wl_container_of(listener, compositor, output_manager_apply);
+	output_manager_apply(compositor, data, false);
+}
+
+void handle_output_manager_test(struct wl_listener *listener, void *data)
+{
+	struct spider_compositor *compositor =
+		wl_container_of(listener, compositor, output_manager_test);
+	output_manager_apply(compositor, data, true);
+}
+
+/* Outputs cache their position in the layout, so that placing surfaces on
+ * them doesn't have to look it up for every surface. */
+void handle_layout_change(struct wl_listener *listener, void *data)
+{
+	struct spider_compositor *compositor =
+		wl_container_of(listener, compositor, layout_change);
+
+	struct spider_output *output;
+	spider_list_for_each(output, &compositor->outputs, link) {
+		struct wlr_output_layout_output *l_output = wlr_output_layout_get(
+				compositor->output_layout, output->wlr_output);
+		if (l_output == NULL) {
+			continue;
+		}
+
+		if (output->lx != l_output->x || output->ly != l_output->y) {
+			output->lx = l_output->x;
+			output->ly = l_output->y;
+			output_damage_whole(output);
+		}
+	}
+
+	scene_update_outputs(compositor->scene);
+	output_manager_update(compositor);
+
+	/* Outputs that were added don't have the cursor image yet */
+	compositor->cursor_image = NULL;
+}
+
+static int output_alloc_index(struct spider_compositor *compositor)
+{
+	uint32_t used = 0;
+	struct spider_output *output;
+	spider_list_for_each(output, &compositor->outputs, link) {
+		if (output->index >= 0) {
+			used |= 1u << output->index;
+		}
+	}
+
+	for (int i = 0; i < 32; i++) {
+		if (!(used & (1u << i))) {
+			return i;
+		}
+	}
+
+	return -1;
 }
 
 /* This event is rasied by the backend when a new output (aka a display or
@@ -172,21 +2053,86 @@ void handle_new_output(struct wl_listener *listener, void *data)
 			wlr_output->model, wlr_output->serial, wlr_output->phys_width,
 			wlr_output->phys_height);
 
-	if (!spider_list_empty(&wlr_output->modes)) {
-		struct wlr_output_mode *mode =
-			wl_container_of(wlr_output->modes.prev, mode, link);
-		wlr_output_set_mode(wlr_output, mode);
-	}
-
 	struct spider_output *output = calloc(1, sizeof(struct spider_output));
 
 	output->wlr_output = wlr_output;
 	output->compositor = compositor;
 	wlr_output->data = output;
+	get_output_config(wlr_output->name, &output->config);
+
+	/* Mirrors show no surfaces of their own */
+	if (output->config.mirror != NULL) {
+		spider_dbg("%s mirrors %s\n", wlr_output->name, output->config.mirror);
+		output->index = -1;
+	}else {
+		output->index = output_alloc_index(compositor);
+		if (output->index < 0) {
+			spider_err("Too many outputs, %s draws every surface\n",
+					wlr_output->name);
+		}
+	}
 	spider_list_insert(&compositor->outputs, &output->link);
+	pixman_region32_init(&output->layer_cache_dirty);
+
+	if (output->config.max_render_time == OUTPUT_CONFIG_UNSET) {
+		output->config.max_render_time = MAX_RENDER_TIME_OFF;
+	}
+	if (output->config.max_render_time == MAX_RENDER_TIME_AUTO) {
+		/* Render right away until the first render time is measured */
+		output->max_render_time = INT_MAX;
+	}else {
+		output->max_render_time = output->config.max_render_time;
+	}
+	if (output->config.adaptive_sync == OUTPUT_CONFIG_UNSET) {
+		output->config.adaptive_sync = 0;
+	}
+	if (output->config.idle_refresh == OUTPUT_CONFIG_UNSET) {
+		output->config.idle_refresh = 0;
+	}
+	if (output->config.format == OUTPUT_CONFIG_UNSET) {
+		output->config.format = OUTPUT_FORMAT_XRGB8888;
+	}
+	if (output->config.format != OUTPUT_FORMAT_XRGB8888 && !g_options.pixman) {
+		/* The backend allocates the buffers the GPU renders into, and
+		 * wlroots has no way to pick their format */
+		spider_dbg("The format of %s only applies to the pixman renderer\n",
+				wlr_output->name);
+		output->config.format = OUTPUT_FORMAT_XRGB8888;
+	}else if (!pixman_render_supports_format(compositor->renderer,
+				output->config.format)) {
+		spider_dbg("The renderer can't take the format of %s, "
+				"it uses XRGB8888\n", wlr_output->name);
+		output->config.format = OUTPUT_FORMAT_XRGB8888;
+	}
+	if (output->config.adaptive_sync == 1 && !wlr_output_is_drm(wlr_output)) {
+		/* Nested and headless outputs have no refresh rate of their own */
+		spider_dbg("Adaptive sync is not available on %s\n", wlr_output->name);
+		output->config.adaptive_sync = 0;
+	}
+
+	if (!spider_list_empty(&wlr_output->modes)) {
+		output_set_initial_mode(output);
+	}
+
+	output->repaint_timer = wl_event_loop_add_timer(
+			wl_display_get_event_loop(compositor->wl_display),
+			output_repaint_timer, output);
+	output->hidden_frame_timer = wl_event_loop_add_timer(
+			wl_display_get_event_loop(compositor->wl_display),
+			output_hidden_frame_timer, output);
+	if (output->config.idle_refresh == 1) {
+		/* Outputs without adaptive sync, e.g. headless, still go
+		 * through the states, which the statistics show */
+		output->refresh_timer = wl_event_loop_add_timer(
+				wl_display_get_event_loop(compositor->wl_display),
+				output_refresh_timer, output);
+		clock_gettime(CLOCK_MONOTONIC, &output->refresh_window_start);
+		wl_event_source_timer_update(output->refresh_timer,
+				REFRESH_WINDOW_MSEC);
+	}
+
+	output->damage = wlr_output_damage_create(wlr_output);
 
-	output->frame.notify = output_handle_frame;
-	wl_signal_add(&wlr_output->events.frame, &output->frame);
 	output->destroy.notify = output_handle_destroy;
 	wl_signal_add(&wlr_output->events.destroy, &output->destroy);
 	output->enable.notify = output_handle_enable;
@@ -198,15 +2144,20 @@ void handle_new_output(struct wl_listener *listener, void *data)
 	output->present.notify = output_handle_present;
 	wl_signal_add(&wlr_output->events.present, &output->present);
 
-	/* TODO handle damage region to reduce overhead */
-	/*
 	output->damage_frame.notify = output_damage_handle_frame;
 	wl_signal_add(&output->damage->events.frame, &output->damage_frame);
 	output->damage_destroy.notify = output_damage_handle_destroy;
 	wl_signal_add(&output->damage->events.destroy, &output->damage_destroy);
-	*/
 
-	wlr_output_layout_add_auto(compositor->output_layout, wlr_output);
+	if (output->config.mirror == NULL) {
+		wlr_output_layout_add_auto(compositor->output_layout, wlr_output);
+	}
 
 	wlr_output_create_global(wlr_output);
+
+	if (output->config.mirror != NULL) {
+		output_damage_mirror(output);
+	}else {
+		output_damage_whole(output);
+	}
 }
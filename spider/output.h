@@ -24,20 +24,108 @@
 #define __SPIDER_OUTPUT_H__
 
 #include <wayland-server.h>
+#include <pixman.h>
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_output_damage.h>
 #include <wlr/types/wlr_output_layout.h>
 #include <stdlib.h>
 #include "spider/compositor.h"
+#include "spider/config.h"
 #include "spider/layer.h"
+#include "spider/offscreen.h"
+#include "spider/stats.h"
 #include "common/util.h"
 
+struct spider_node;
+
+#define RENDER_TIME_SAMPLES		32
+#define RENDER_TIME_HEADROOM_USEC	1500
+#define HIDDEN_FRAME_INTERVAL_MSEC	1000
+/* With idle_refresh, an output drawing at most REFRESH_IDLE_FRAMES frames
+ * in REFRESH_WINDOW_MSEC counts as idle */
+#define REFRESH_WINDOW_MSEC		1000
+#define REFRESH_IDLE_FRAMES		2
+
 struct spider_output {
 	struct spider_list link;
 	struct spider_compositor *compositor;
 	struct wlr_output *wlr_output;
+	struct wlr_output_damage *damage;
+	bool scanned_out;
+	/* Powered down by the idle timeout */
+	bool idle_blanked;
+	/* Position in the output layout */
+	int lx, ly;
+	/* Bit of this output in the scene's per-surface output masks, or -1 */
+	int index;
+
+	struct spider_output_config config;
+
+	/* Frame scheduling */
+	struct wl_event_source *repaint_timer;
+	/* Frame events of surfaces hidden behind opaque ones */
+	struct wl_event_source *hidden_frame_timer;
+	int max_render_time;
+	struct timespec last_presentation;
+	int refresh_nsec;
+	int render_time_usec[RENDER_TIME_SAMPLES];
+	int render_time_idx;
+
+	/* Timing statistics, dumped with SIGUSR1 and reset with SIGUSR2 */
+	struct {
+		struct timespec frame_event;
+		struct timespec commit;
+		bool presentation_pending;
+
+		uint32_t frames;
+		uint32_t missed_vblanks;
+		struct spider_histogram frame_to_commit;
+		struct spider_histogram render;
+		struct spider_histogram commit_to_present;
+
+		uint32_t refresh_low_switches;
+		struct timespec refresh_low_start;
+		uint64_t refresh_low_usec;
+	} stats;
+
+	/* Pixman rendering: the composited frame, and its copy on the GPU */
+	pixman_image_t *shadow;
+	struct wlr_texture *shadow_texture;
+
+	/* The background and status bar rarely change but are drawn under
+	 * everything else. With GLES2 they are drawn into this texture, which
+	 * is only redrawn where it is dirty (in output coordinates, like the
+	 * damage), and frames copy what they need from it. */
+	struct spider_offscreen layer_cache;
+	pixman_region32_t layer_cache_dirty;
+
+	/* With mirrors, the scene is composited in here once and copied to
+	 * this output and all of its mirrors */
+	struct spider_offscreen frame;
+	/* Surface a mirror failed to scan out, which this output mustn't
+	 * scan out either */
+	struct wlr_surface *mirror_scanout_failed;
+	struct wl_listener mirror_scanout_failed_destroy;
+	/* Bumped for every client buffer this output scans out. Mirrors keep
+	 * the count of the source's buffer they show last. */
+	uint32_t scanout_seq;
+	uint32_t mirror_scanout_seq;
+
+	/* Idle refresh: frames drawn in the current window, and whether the
+	 * panel is let down to its minimum refresh with adaptive sync */
+	struct wl_event_source *refresh_timer;
+	struct timespec refresh_window_start;
+	int refresh_window_frames;
+	bool refresh_low;
+
+	/* Adaptive sync, and the refresh rate it actually results in */
+	bool adaptive_sync_failed;
+	struct timespec refresh_report_start;
+	int refresh_report_frames;
 
-	struct wl_listener frame;
+	struct wl_listener damage_frame;
+	struct wl_listener damage_destroy;
 	struct wl_listener destroy;
 	struct wl_listener enable;
 	struct wl_listener mode;
@@ -46,5 +134,20 @@ struct spider_output {
 };
 
 void handle_new_output(struct wl_listener *listener, void *data);
+void handle_layout_change(struct wl_listener *listener, void *data);
+void handle_output_manager_apply(struct wl_listener *listener, void *data);
+void handle_output_manager_test(struct wl_listener *listener, void *data);
+bool output_set_power(struct spider_output *output, bool on);
+void output_notify_activity(struct spider_output *output);
+void output_damage_whole(struct spider_output *output);
+void output_dump_stats(struct spider_output *output, FILE *f);
+void output_reset_stats(struct spider_output *output);
+void output_damage_box(struct spider_output *output, struct wlr_box *box);
+void output_damage_layer_cache(struct spider_output *output, struct wlr_box *box);
+void output_node_box(struct spider_output *output,
+		struct spider_node *node, struct wlr_box *box);
+void output_damage_surface(struct spider_output *output,
+		struct wlr_surface *surface, double lx, double ly, bool whole,
+		bool cached);
 
 #endif
@@ -0,0 +1,288 @@
+/*
+ * Copyright (c) 2019 Minyoung.Go <hedone21@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <wayland-server.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/render/wlr_texture.h>
+#include "spider/compositor.h"
+#include "spider/pixman_render.h"
+#include "spider/viewporter.h"
+#include "common/log.h"
+
+static bool shm_format_to_pixman(uint32_t shm_format,
+		pixman_format_code_t *format)
+{
+	switch (shm_format) {
+	case WL_SHM_FORMAT_ARGB8888:
+		*format = PIXMAN_a8r8g8b8;
+		return true;
+	case WL_SHM_FORMAT_XRGB8888:
+		*format = PIXMAN_x8r8g8b8;
+		return true;
+	case WL_SHM_FORMAT_RGB565:
+		*format = PIXMAN_r5g6b5;
+		return true;
+	default:
+		return false;
+	}
+}
+
+void pixman_render_node_finish(struct spider_node *node)
+{
+	if (node->image != NULL) {
+		pixman_image_unref(node->image);
+		node->image = NULL;
+	}
+}
+
+/* Copies what the client changed into the node's image. This runs from the
+ * commit handler, before the release of the buffer reaches the client, so
+ * the buffer still holds the committed content. */
+void pixman_render_surface_commit(struct spider_node *node)
+{
+	struct wlr_surface *surface = node->surface;
+	struct wl_resource *resource = surface->current.buffer_resource;
+
+	if (!(surface->current.committed & WLR_SURFACE_STATE_BUFFER)) {
+		return;
+	}
+
+	struct wl_shm_buffer *shm_buffer = NULL;
+	if (resource != NULL) {
+		shm_buffer = wl_shm_buffer_get(resource);
+	}
+	pixman_format_code_t format;
+	if (shm_buffer == NULL ||
+			!shm_format_to_pixman(wl_shm_buffer_get_format(shm_buffer), &format)) {
+		/* Unmapped, or a buffer only the GPU can read */
+		pixman_render_node_finish(node);
+		return;
+	}
+
+	int width = wl_shm_buffer_get_width(shm_buffer);
+	int height = wl_shm_buffer_get_height(shm_buffer);
+	int stride = wl_shm_buffer_get_stride(shm_buffer);
+
+	pixman_region32_t *damage = &surface->buffer_damage;
+	if (node->image == NULL || pixman_image_get_format(node->image) != format ||
+			pixman_image_get_width(node->image) != width ||
+			pixman_image_get_height(node->image) != height) {
+		pixman_render_node_finish(node);
+		node->image = pixman_image_create_bits_no_clear(format,
+				width, height, NULL, 0);
+		if (node->image == NULL) {
+			spider_err("Failed to allocate a %dx%d surface image\n",
+					width, height);
+			return;
+		}
+		damage = NULL;
+	}
+
+	wl_shm_buffer_begin_access(shm_buffer);
+	pixman_image_t *src = pixman_image_create_bits_no_clear(format,
+			width, height, wl_shm_buffer_get_data(shm_buffer), stride);
+	if (src != NULL) {
+		pixman_image_set_clip_region32(node->image, damage);
+		pixman_image_composite32(PIXMAN_OP_SRC, src, NULL, node->image,
+				0, 0, 0, 0, 0, 0, width, height);
+		pixman_image_set_clip_region32(node->image, NULL);
+		pixman_image_unref(src);
+	}
+	wl_shm_buffer_end_access(shm_buffer);
+}
+
+/* Returns whether the renderer can upload a shadow image in the given
+ * OUTPUT_FORMAT_*. */
+bool pixman_render_supports_format(struct wlr_renderer *renderer, int format)
+{
+	if (format != OUTPUT_FORMAT_RGB565) {
+		return true;
+	}
+
+	size_t len;
+	const enum wl_shm_format *formats = wlr_renderer_get_formats(renderer, &len);
+	for (size_t i = 0; i < len; i++) {
+		if (formats[i] == WL_SHM_FORMAT_RGB565) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Picks the format of the output's shadow image. RGB565 halves what is
+ * written while compositing and uploaded afterwards. Surfaces in the same
+ * format are then composited without any conversion. The output only keeps
+ * a format the renderer takes. */
+static void shadow_format(struct spider_output *output,
+		pixman_format_code_t *format, uint32_t *shm_format)
+{
+	if (output->config.format == OUTPUT_FORMAT_RGB565) {
+		*format = PIXMAN_r5g6b5;
+		*shm_format = WL_SHM_FORMAT_RGB565;
+	}else {
+		*format = PIXMAN_x8r8g8b8;
+		*shm_format = WL_SHM_FORMAT_XRGB8888;
+	}
+}
+
+/* (Re)creates the shadow image and its texture for the output size. Returns
+ * true if the shadow is new and has to be composited as a whole. */
+bool pixman_render_ensure_shadow(struct spider_output *output,
+		int width, int height)
+{
+	struct wlr_renderer *renderer = output->compositor->renderer;
+
+	if (output->shadow != NULL &&
+			pixman_image_get_width(output->shadow) == width &&
+			pixman_image_get_height(output->shadow) == height) {
+		return false;
+	}
+
+	pixman_format_code_t format;
+	uint32_t shm_format;
+	shadow_format(output, &format, &shm_format);
+
+	pixman_render_output_finish(output);
+	output->shadow = pixman_image_create_bits_no_clear(format,
+			width, height, NULL, 0);
+	if (output->shadow == NULL) {
+		spider_err("Failed to allocate the shadow image of %s\n",
+				output->wlr_output->name);
+		return false;
+	}
+	output->shadow_texture = wlr_texture_from_pixels(renderer,
+			shm_format, pixman_image_get_stride(output->shadow),
+			width, height, pixman_image_get_data(output->shadow));
+
+	return true;
+}
+
+void pixman_render_output_finish(struct spider_output *output)
+{
+	if (output->shadow_texture != NULL) {
+		wlr_texture_destroy(output->shadow_texture);
+		output->shadow_texture = NULL;
+	}
+	if (output->shadow != NULL) {
+		pixman_image_unref(output->shadow);
+		output->shadow = NULL;
+	}
+}
+
+static void render_node(struct spider_node *node, void *data)
+{
+	struct spider_output *output = data;
+	pixman_image_t *image = node->image;
+
+	if (image == NULL || !pixman_region32_not_empty(&node->visible)) {
+		return;
+	}
+	if (node->surface->current.transform != WL_OUTPUT_TRANSFORM_NORMAL) {
+		/* Rotated buffers are left to GPU compositing */
+		return;
+	}
+
+	struct wlr_box box;
+	output_node_box(output, node, &box);
+	/* A snapshot is stretched to the box as a whole */
+	if (node->snapshot == NULL) {
+		viewport_buffer_box(node->surface, &box);
+	}
+	if (box.width <= 0 || box.height <= 0) {
+		return;
+	}
+
+	/* Buffer scale, output scale and the viewport may not match. While
+	 * the view is resized, the latest copy is stretched to its snapshot
+	 * size. */
+	int width = pixman_image_get_width(image);
+	int height = pixman_image_get_height(image);
+	bool scaled = width != box.width || height != box.height;
+	if (scaled) {
+		struct pixman_transform transform;
+		pixman_transform_init_scale(&transform,
+				pixman_double_to_fixed((double)width / box.width),
+				pixman_double_to_fixed((double)height / box.height));
+		pixman_image_set_transform(image, &transform);
+		pixman_image_set_filter(image, PIXMAN_FILTER_BILINEAR, NULL, 0);
+	}
+
+	/* pixman picks SIMD fast paths for both operators. SRC skips reading
+	 * the destination where nothing shows through. */
+	pixman_region32_t translucent;
+	pixman_region32_init(&translucent);
+	pixman_region32_subtract(&translucent, &node->visible,
+			&node->visible_opaque);
+	if (pixman_region32_not_empty(&translucent)) {
+		pixman_image_set_clip_region32(output->shadow, &translucent);
+		pixman_image_composite32(PIXMAN_OP_OVER, image, NULL, output->shadow,
+				0, 0, 0, 0, box.x, box.y, box.width, box.height);
+	}
+	pixman_region32_fini(&translucent);
+
+	if (pixman_region32_not_empty(&node->visible_opaque)) {
+		pixman_image_set_clip_region32(output->shadow, &node->visible_opaque);
+		pixman_image_composite32(PIXMAN_OP_SRC, image, NULL, output->shadow,
+				0, 0, 0, 0, box.x, box.y, box.width, box.height);
+	}
+
+	if (scaled) {
+		pixman_image_set_transform(image, NULL);
+	}
+}
+
+/* Composites the damaged part of the scene into the shadow image and uploads
+ * it to the shadow texture. node->visible must already hold the part of the
+ * damage each surface shows through, and opaque what they cover together. */
+void pixman_render_scene(struct spider_output *output,
+		pixman_region32_t *damage, pixman_region32_t *opaque)
+{
+	pixman_image_t *shadow = output->shadow;
+	if (shadow == NULL) {
+		return;
+	}
+
+	pixman_region32_t background;
+	pixman_region32_init(&background);
+	pixman_region32_subtract(&background, damage, opaque);
+
+	int nrects;
+	pixman_box32_t *rects = pixman_region32_rectangles(&background, &nrects);
+	pixman_color_t black = { 0, 0, 0, 0xffff };
+	pixman_image_fill_boxes(PIXMAN_OP_SRC, shadow, &black, nrects, rects);
+	pixman_region32_fini(&background);
+
+	scene_for_each_surface(output->compositor->scene, render_node, output);
+	pixman_image_set_clip_region32(shadow, NULL);
+
+	if (output->shadow_texture == NULL) {
+		return;
+	}
+	int stride = pixman_image_get_stride(shadow);
+	uint32_t *data = pixman_image_get_data(shadow);
+	rects = pixman_region32_rectangles(damage, &nrects);
+	for (int i = 0; i < nrects; i++) {
+		wlr_texture_write_pixels(output->shadow_texture, stride,
+				rects[i].x2 - rects[i].x1, rects[i].y2 - rects[i].y1,
+				rects[i].x1, rects[i].y1, rects[i].x1, rects[i].y1, data);
+	}
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2019 Minyoung.Go <hedone21@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __SPIDER_PIXMAN_RENDER_H__
+#define __SPIDER_PIXMAN_RENDER_H__
+
+#include <pixman.h>
+#include <stdbool.h>
+#include "spider/output.h"
+#include "spider/scene.h"
+
+/* CPU compositing for devices without a usable GPU. Surfaces keep a copy of
+ * their wl_shm buffer, which is composited with pixman into a persistent
+ * shadow image per output. The backend's renderer then only has to copy the
+ * damaged part of that image into the output buffer. */
+
+void pixman_render_surface_commit(struct spider_node *node);
+void pixman_render_node_finish(struct spider_node *node);
+
+bool pixman_render_supports_format(struct wlr_renderer *renderer, int format);
+bool pixman_render_ensure_shadow(struct spider_output *output,
+		int width, int height);
+void pixman_render_scene(struct spider_output *output,
+		pixman_region32_t *damage, pixman_region32_t *opaque);
+void pixman_render_output_finish(struct spider_output *output);
+
+#endif
@@ -0,0 +1,938 @@
+/*
+ * Copyright (c) 2019 Minyoung.Go <hedone21@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/types/wlr_surface.h>
+#include <wlr/types/wlr_xdg_shell.h>
+#include "spider/compositor.h"
+#include "spider/output.h"
+#include "spider/pixman_render.h"
+#include "spider/scene.h"
+#include "spider/view.h"
+#include "spider/viewporter.h"
+#include "common/log.h"
+
+static struct spider_node *node_create_subsurface(struct spider_node *parent,
+		struct wlr_subsurface *subsurface);
+static struct spider_node *node_create_popup(struct spider_node *parent,
+		struct wlr_xdg_popup *popup);
+
+static void node_init(struct spider_node *node, struct spider_scene *scene,
+		enum spider_node_type type, struct spider_node *parent)
+{
+	node->type = type;
+	node->scene = scene;
+	node->parent = parent;
+	node->enabled = true;
+	spider_list_init(&node->children);
+	pixman_region32_init(&node->visible);
+	pixman_region32_init(&node->visible_opaque);
+
+	spider_list_init(&node->surface_commit.link);
+	spider_list_init(&node->buffer_destroy.link);
+	spider_list_init(&node->new_subsurface.link);
+	spider_list_init(&node->new_popup.link);
+	spider_list_init(&node->subsurface_map.link);
+	spider_list_init(&node->subsurface_unmap.link);
+	spider_list_init(&node->subsurface_destroy.link);
+	spider_list_init(&node->popup_map.link);
+	spider_list_init(&node->popup_unmap.link);
+	spider_list_init(&node->popup_destroy.link);
+
+	if (parent != NULL) {
+		node->view = parent->view;
+		node->lx = parent->lx;
+		node->ly = parent->ly;
+		spider_list_insert_tail(&parent->children, &node->link);
+	} else {
+		spider_list_init(&node->link);
+	}
+}
+
+static struct spider_node *node_create(struct spider_node *parent,
+		enum spider_node_type type)
+{
+	struct spider_node *node = calloc(1, sizeof(struct spider_node));
+	if (node == NULL) {
+		spider_err("Allocation Failed\n");
+		return NULL;
+	}
+
+	node_init(node, parent->scene, type, parent);
+	return node;
+}
+
+static uint32_t output_mask(struct spider_output *output)
+{
+	if (output->index < 0) {
+		return 0;
+	}
+
+	return 1u << output->index;
+}
+
+static void node_update_outputs(struct spider_node *node)
+{
+	struct spider_compositor *compositor = node->scene->compositor;
+	struct spider_output *output;
+
+	struct wlr_box box = {
+		.x = node->lx,
+		.y = node->ly,
+		.width = node->width,
+		.height = node->height,
+	};
+
+	uint32_t outputs = 0;
+	struct spider_output *primary_output = NULL;
+	int primary_area = 0;
+	spider_list_for_each(output, &compositor->outputs, link) {
+		/* Mirrors aren't part of the layout */
+		if (output->config.mirror != NULL) {
+			continue;
+		}
+
+		struct wlr_box output_box = {
+			.x = output->lx,
+			.y = output->ly,
+		};
+		wlr_output_effective_resolution(output->wlr_output,
+				&output_box.width, &output_box.height);
+
+		struct wlr_box intersection;
+		if (!wlr_box_intersection(&intersection, &output_box, &box)) {
+			continue;
+		}
+
+		outputs |= output_mask(output);
+		int area = intersection.width * intersection.height;
+		if (area > primary_area) {
+			primary_area = area;
+			primary_output = output;
+		}
+	}
+	node->primary_output = primary_output;
+
+	uint32_t changed = outputs ^ node->outputs;
+	node->outputs = outputs;
+	if (changed == 0) {
+		return;
+	}
+
+	spider_list_for_each(output, &compositor->outputs, link) {
+		if (!(changed & output_mask(output))) {
+			continue;
+		}
+		if (outputs & output_mask(output)) {
+			wlr_surface_send_enter(node->surface, output->wlr_output);
+		} else {
+			wlr_surface_send_leave(node->surface, output->wlr_output);
+		}
+	}
+}
+
+bool scene_node_on_output(struct spider_node *node, struct spider_output *output)
+{
+	/* Outputs beyond the mask width are not tracked, so draw everything
+	 * on them. */
+	if (output->index < 0) {
+		return true;
+	}
+
+	return node->outputs & output_mask(output);
+}
+
+static void node_update_position(struct spider_node *node)
+{
+	if (node->parent != NULL) {
+		node->lx = node->parent->lx + node->x;
+		node->ly = node->parent->ly + node->y;
+	}
+	if (node->surface != NULL) {
+		node_update_outputs(node);
+	}
+
+	struct spider_node *child;
+	spider_list_for_each(child, &node->children, link) {
+		node_update_position(child);
+	}
+}
+
+bool scene_node_is_visible(struct spider_node *node)
+{
+	for (; node != NULL; node = node->parent) {
+		if (!node->enabled) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* Whether the node is in one of the layers drawn from the layer cache */
+bool scene_node_is_cached(struct spider_node *node)
+{
+	struct spider_scene *scene = node->scene;
+
+	for (; node->parent != NULL; node = node->parent) {
+		if (node->parent == &scene->root) {
+			return node - scene->layers <= LAYER_CACHE_TOP;
+		}
+	}
+
+	return false;
+}
+
+static void node_damage_whole(struct spider_node *node, bool cached)
+{
+	if (!node->enabled) {
+		return;
+	}
+
+	if (node->surface != NULL) {
+		struct wlr_box box = {
+			.x = node->lx,
+			.y = node->ly,
+			.width = node->width,
+			.height = node->height,
+		};
+
+		struct spider_output *output;
+		spider_list_for_each(output, &node->scene->compositor->outputs, link) {
+			output_damage_box(output, &box);
+			if (cached) {
+				output_damage_layer_cache(output, &box);
+			}
+		}
+	}
+
+	struct spider_node *child;
+	spider_list_for_each(child, &node->children, link) {
+		node_damage_whole(child, cached);
+	}
+}
+
+void scene_node_damage_whole(struct spider_node *node)
+{
+	if (!scene_node_is_visible(node)) {
+		return;
+	}
+
+	node_damage_whole(node, scene_node_is_cached(node));
+}
+
+static void node_damage_surface(struct spider_node *node)
+{
+	bool cached = scene_node_is_cached(node);
+
+	struct spider_output *output;
+	spider_list_for_each(output, &node->scene->compositor->outputs, link) {
+		output_damage_surface(output, node->surface, node->lx, node->ly,
+				false, cached);
+	}
+}
+
+void scene_node_set_position(struct spider_node *node, int x, int y)
+{
+	if (node->x == x && node->y == y) {
+		return;
+	}
+
+	scene_node_damage_whole(node);
+	node->x = x;
+	node->y = y;
+	node_update_position(node);
+	scene_node_damage_whole(node);
+}
+
+void scene_node_set_enabled(struct spider_node *node, bool enabled)
+{
+	if (node->enabled == enabled) {
+		return;
+	}
+
+	/* Damage while the node is still visible when hiding it, and once it is
+	 * visible when showing it. */
+	scene_node_damage_whole(node);
+	node->enabled = enabled;
+	scene_node_damage_whole(node);
+}
+
+void scene_node_reparent(struct spider_node *node, struct spider_node *parent)
+{
+	if (node->parent == parent) {
+		return;
+	}
+
+	scene_node_damage_whole(node);
+	spider_list_remove(&node->link);
+	spider_list_insert_tail(&parent->children, &node->link);
+	node->parent = parent;
+	node_update_position(node);
+	scene_node_damage_whole(node);
+}
+
+void scene_node_raise_to_top(struct spider_node *node)
+{
+	struct spider_list *children = &node->parent->children;
+	if (children->prev == &node->link) {
+		return;
+	}
+
+	spider_list_remove(&node->link);
+	spider_list_insert_tail(children, &node->link);
+	scene_node_damage_whole(node);
+}
+
+void scene_node_lower_to_bottom(struct spider_node *node)
+{
+	struct spider_list *children = &node->parent->children;
+	if (children->next == &node->link) {
+		return;
+	}
+
+	scene_node_damage_whole(node);
+	spider_list_remove(&node->link);
+	spider_list_insert(children, &node->link);
+}
+
+void scene_node_destroy(struct spider_node *node)
+{
+	if (node == NULL) {
+		return;
+	}
+
+	scene_node_damage_whole(node);
+
+	struct spider_node *child, *tmp;
+	spider_list_for_each_safe(child, tmp, &node->children, link) {
+		/* Already damaged along with this node */
+		child->enabled = false;
+		scene_node_destroy(child);
+	}
+
+	if (node->subsurface != NULL) {
+		node->subsurface->data = NULL;
+	}
+	if (node->popup != NULL) {
+		node->popup->base->data = NULL;
+	}
+
+	spider_list_remove(&node->surface_commit.link);
+	spider_list_remove(&node->buffer_destroy.link);
+	spider_list_remove(&node->new_subsurface.link);
+	spider_list_remove(&node->new_popup.link);
+	spider_list_remove(&node->subsurface_map.link);
+	spider_list_remove(&node->subsurface_unmap.link);
+	spider_list_remove(&node->subsurface_destroy.link);
+	spider_list_remove(&node->popup_map.link);
+	spider_list_remove(&node->popup_unmap.link);
+	spider_list_remove(&node->popup_destroy.link);
+
+	pixman_region32_fini(&node->visible);
+	pixman_region32_fini(&node->visible_opaque);
+	pixman_render_node_finish(node);
+	if (node->snapshot != NULL) {
+		wlr_buffer_unlock(&node->snapshot->base);
+	}
+	spider_list_remove(&node->link);
+	free(node);
+}
+
+static void node_update_popup_position(struct spider_node *node)
+{
+	struct wlr_xdg_popup *popup = node->popup;
+	if (!wlr_surface_is_xdg_surface(popup->parent)) {
+		return;
+	}
+
+	struct wlr_xdg_surface *parent =
+		wlr_xdg_surface_from_wlr_surface(popup->parent);
+	struct wlr_box parent_geo;
+	wlr_xdg_surface_get_geometry(parent, &parent_geo);
+
+	scene_node_set_position(node,
+			parent_geo.x + popup->geometry.x - popup->base->geometry.x,
+			parent_geo.y + popup->geometry.y - popup->base->geometry.y);
+}
+
+static void node_update_children(struct spider_node *node)
+{
+	struct wlr_surface *surface = node->surface;
+	struct spider_node *child, *tmp;
+	struct wlr_subsurface *subsurface;
+
+	/* Subsurface state is applied when the parent commits. Popups always stay
+	 * on top of subsurfaces, so set them aside while checking the order. */
+	struct spider_list popups;
+	spider_list_init(&popups);
+	spider_list_for_each_safe(child, tmp, &node->children, link) {
+		if (child->type == SPIDER_NODE_POPUP) {
+			spider_list_remove(&child->link);
+			spider_list_insert_tail(&popups, &child->link);
+		}
+	}
+
+	bool reordered = false;
+	struct spider_list *pos = node->children.next;
+	spider_list_for_each(subsurface, &surface->subsurfaces, parent_link) {
+		child = subsurface->data;
+		if (child == NULL || child->parent != node) {
+			continue;
+		}
+		if (&child->link != pos) {
+			reordered = true;
+			break;
+		}
+		pos = pos->next;
+	}
+
+	if (reordered) {
+		scene_node_damage_whole(node);
+		spider_list_for_each(subsurface, &surface->subsurfaces, parent_link) {
+			child = subsurface->data;
+			if (child == NULL || child->parent != node) {
+				continue;
+			}
+			spider_list_remove(&child->link);
+			spider_list_insert_tail(&node->children, &child->link);
+		}
+	}
+	spider_list_insert_list(node->children.prev, &popups);
+
+	spider_list_for_each(subsurface, &surface->subsurfaces, parent_link) {
+		child = subsurface->data;
+		if (child == NULL || child->parent != node) {
+			continue;
+		}
+		scene_node_set_position(child,
+				subsurface->current.x, subsurface->current.y);
+	}
+
+	spider_list_for_each(child, &node->children, link) {
+		if (child->type == SPIDER_NODE_POPUP) {
+			node_update_popup_position(child);
+		}
+	}
+}
+
+static void node_handle_buffer_destroy(struct wl_listener *listener,
+		void *data)
+{
+	struct spider_node *node = wl_container_of(listener, node, buffer_destroy);
+	spider_list_remove(&node->buffer_destroy.link);
+	spider_list_init(&node->buffer_destroy.link);
+	node->buffer = NULL;
+}
+
+static void node_set_buffer(struct spider_node *node,
+		struct wlr_client_buffer *buffer)
+{
+	if (buffer == node->buffer) {
+		return;
+	}
+
+	spider_list_remove(&node->buffer_destroy.link);
+	spider_list_init(&node->buffer_destroy.link);
+	node->buffer = buffer;
+	if (buffer != NULL) {
+		node->buffer_destroy.notify = node_handle_buffer_destroy;
+		wl_signal_add(&buffer->base.events.destroy, &node->buffer_destroy);
+	}
+}
+
+/* Counts what the commit cost in texture uploads. wlroots writes only the
+ * buffer damage of a wl_shm buffer into the texture of the previous one if
+ * nothing else holds that buffer, and uploads the whole buffer otherwise. */
+static void node_account_upload(struct spider_node *node)
+{
+	struct spider_scene *scene = node->scene;
+	struct wlr_surface *surface = node->surface;
+	struct wl_resource *resource = surface->current.buffer_resource;
+
+	struct wlr_client_buffer *previous = node->buffer;
+	node_set_buffer(node, surface->buffer);
+
+	if (!(surface->current.committed & WLR_SURFACE_STATE_BUFFER) ||
+			resource == NULL || surface->buffer == NULL) {
+		return;
+	}
+	struct wl_shm_buffer *shm_buffer = wl_shm_buffer_get(resource);
+	if (shm_buffer == NULL) {
+		return;
+	}
+
+	int stride = wl_shm_buffer_get_stride(shm_buffer);
+	if (surface->buffer != previous) {
+		scene->stats.full_uploads++;
+		scene->stats.full_bytes += (uint64_t)stride *
+			wl_shm_buffer_get_height(shm_buffer);
+		return;
+	}
+
+	int width = wl_shm_buffer_get_width(shm_buffer);
+	int nrects;
+	pixman_box32_t *rects =
+		pixman_region32_rectangles(&surface->buffer_damage, &nrects);
+	scene->stats.partial_uploads++;
+	for (int i = 0; i < nrects; i++) {
+		scene->stats.partial_bytes += (uint64_t)stride / width *
+			(rects[i].x2 - rects[i].x1) * (rects[i].y2 - rects[i].y1);
+	}
+}
+
+static void node_handle_surface_commit(struct wl_listener *listener, void *data)
+{
+	struct spider_node *node = wl_container_of(listener, node, surface_commit);
+	struct wlr_surface *surface = node->surface;
+
+	viewport_commit(surface);
+	node_account_upload(node);
+	if (g_options.pixman) {
+		pixman_render_surface_commit(node);
+	}
+
+	if (node->type == SPIDER_NODE_POPUP) {
+		node_update_popup_position(node);
+	}
+	node_update_children(node);
+
+	if (node->snapshot != NULL) {
+		/* Shown once the snapshot is dropped */
+		return;
+	}
+
+	int width, height;
+	viewport_surface_size(surface, &width, &height);
+	if (node->width != width || node->height != height) {
+		/* Repaint the area the old size covered as well */
+		scene_node_damage_whole(node);
+		node->width = width;
+		node->height = height;
+		node_update_outputs(node);
+		scene_node_damage_whole(node);
+	} else if (scene_node_is_visible(node)) {
+		node_damage_surface(node);
+	}
+}
+
+struct wlr_texture *scene_node_get_texture(struct spider_node *node)
+{
+	if (node->snapshot != NULL) {
+		return node->snapshot->texture;
+	}
+
+	return wlr_surface_get_texture(node->surface);
+}
+
+/* Freezes what the surface shows now, or replaces the snapshot with the
+ * surface's current buffer. The surface's commits are still applied but not
+ * shown until the snapshot is dropped. Returns false if the surface has
+ * nothing to show. */
+bool scene_node_snapshot(struct spider_node *node)
+{
+	struct wlr_client_buffer *buffer = node->surface->buffer;
+	if (buffer == NULL || buffer->texture == NULL) {
+		return false;
+	}
+	if (buffer == node->snapshot) {
+		return true;
+	}
+
+	/* Holding the buffer keeps wlroots from writing the next wl_shm
+	 * commit into its texture */
+	scene_node_damage_whole(node);
+	wlr_buffer_lock(&buffer->base);
+	if (node->snapshot != NULL) {
+		wlr_buffer_unlock(&node->snapshot->base);
+	}
+	node->snapshot = buffer;
+	scene_node_damage_whole(node);
+	return true;
+}
+
+void scene_node_set_snapshot_size(struct spider_node *node,
+		int width, int height)
+{
+	if (node->snapshot == NULL ||
+			(node->width == width && node->height == height)) {
+		return;
+	}
+
+	scene_node_damage_whole(node);
+	node->width = width;
+	node->height = height;
+	node_update_outputs(node);
+	scene_node_damage_whole(node);
+}
+
+/* Shows the live surface again, at its own size */
+void scene_node_drop_snapshot(struct spider_node *node)
+{
+	if (node->snapshot == NULL) {
+		return;
+	}
+
+	scene_node_damage_whole(node);
+	wlr_buffer_unlock(&node->snapshot->base);
+	node->snapshot = NULL;
+	viewport_surface_size(node->surface, &node->width, &node->height);
+	node_update_outputs(node);
+	scene_node_damage_whole(node);
+}
+
+static void node_handle_new_subsurface(struct wl_listener *listener, void *data)
+{
+	struct spider_node *node = wl_container_of(listener, node, new_subsurface);
+	struct wlr_subsurface *subsurface = data;
+
+	node_create_subsurface(node, subsurface);
+}
+
+static void node_handle_new_popup(struct wl_listener *listener, void *data)
+{
+	struct spider_node *node = wl_container_of(listener, node, new_popup);
+	struct wlr_xdg_popup *popup = data;
+
+	node_create_popup(node, popup);
+}
+
+static void node_set_surface(struct spider_node *node, struct wlr_surface *surface)
+{
+	node->surface = surface;
+	node_set_buffer(node, surface->buffer);
+	viewport_surface_size(surface, &node->width, &node->height);
+	node_update_outputs(node);
+
+	node->surface_commit.notify = node_handle_surface_commit;
+	wl_signal_add(&surface->events.commit, &node->surface_commit);
+	node->new_subsurface.notify = node_handle_new_subsurface;
+	wl_signal_add(&surface->events.new_subsurface, &node->new_subsurface);
+
+	/* Subsurfaces created before the surface entered the scene */
+	struct wlr_subsurface *subsurface;
+	spider_list_for_each(subsurface, &surface->subsurfaces, parent_link) {
+		node_create_subsurface(node, subsurface);
+	}
+}
+
+static void node_handle_subsurface_map(struct wl_listener *listener, void *data)
+{
+	struct spider_node *node = wl_container_of(listener, node, subsurface_map);
+
+	scene_node_set_enabled(node, true);
+}
+
+static void node_handle_subsurface_unmap(struct wl_listener *listener, void *data)
+{
+	struct spider_node *node = wl_container_of(listener, node, subsurface_unmap);
+
+	scene_node_set_enabled(node, false);
+}
+
+static void node_handle_subsurface_destroy(struct wl_listener *listener, void *data)
+{
+	struct spider_node *node = wl_container_of(listener, node, subsurface_destroy);
+
+	scene_node_destroy(node);
+}
+
+static struct spider_node *node_create_subsurface(struct spider_node *parent,
+		struct wlr_subsurface *subsurface)
+{
+	struct spider_node *node = node_create(parent, SPIDER_NODE_SUBSURFACE);
+	if (node == NULL) {
+		return NULL;
+	}
+
+	node->subsurface = subsurface;
+	subsurface->data = node;
+	node->enabled = subsurface->mapped;
+	node->x = subsurface->current.x;
+	node->y = subsurface->current.y;
+	node_update_position(node);
+
+	node->subsurface_map.notify = node_handle_subsurface_map;
+	wl_signal_add(&subsurface->events.map, &node->subsurface_map);
+	node->subsurface_unmap.notify = node_handle_subsurface_unmap;
+	wl_signal_add(&subsurface->events.unmap, &node->subsurface_unmap);
+	node->subsurface_destroy.notify = node_handle_subsurface_destroy;
+	wl_signal_add(&subsurface->events.destroy, &node->subsurface_destroy);
+
+	node_set_surface(node, subsurface->surface);
+	scene_node_damage_whole(node);
+
+	return node;
+}
+
+static void node_handle_popup_map(struct wl_listener *listener, void *data)
+{
+	struct spider_node *node = wl_container_of(listener, node, popup_map);
+
+	node_update_popup_position(node);
+	scene_node_set_enabled(node, true);
+}
+
+static void node_handle_popup_unmap(struct wl_listener *listener, void *data)
+{
+	struct spider_node *node = wl_container_of(listener, node, popup_unmap);
+
+	scene_node_set_enabled(node, false);
+}
+
+static void node_handle_popup_destroy(struct wl_listener *listener, void *data)
+{
+	struct spider_node *node = wl_container_of(listener, node, popup_destroy);
+
+	scene_node_destroy(node);
+}
+
+static struct spider_node *node_create_popup(struct spider_node *parent,
+		struct wlr_xdg_popup *popup)
+{
+	struct spider_node *node = node_create(parent, SPIDER_NODE_POPUP);
+	if (node == NULL) {
+		return NULL;
+	}
+
+	struct wlr_xdg_surface *xdg_surface = popup->base;
+	node->popup = popup;
+	xdg_surface->data = node;
+	node->enabled = xdg_surface->mapped;
+
+	node->popup_map.notify = node_handle_popup_map;
+	wl_signal_add(&xdg_surface->events.map, &node->popup_map);
+	node->popup_unmap.notify = node_handle_popup_unmap;
+	wl_signal_add(&xdg_surface->events.unmap, &node->popup_unmap);
+	node->popup_destroy.notify = node_handle_popup_destroy;
+	wl_signal_add(&xdg_surface->events.destroy, &node->popup_destroy);
+	node->new_popup.notify = node_handle_new_popup;
+	wl_signal_add(&xdg_surface->events.new_popup, &node->new_popup);
+
+	node_set_surface(node, xdg_surface->surface);
+	node_update_popup_position(node);
+
+	return node;
+}
+
+struct spider_node *scene_add_view(struct spider_scene *scene,
+		struct spider_view *view)
+{
+	struct spider_node *node = node_create(&scene->layers[view->layer],
+			SPIDER_NODE_VIEW);
+	if (node == NULL) {
+		return NULL;
+	}
+	node->view = view;
+	node->enabled = view->mapped;
+	node->x = view->box.x;
+	node->y = view->box.y;
+	node_update_position(node);
+
+	struct spider_node *surface_node = node_create(node, SPIDER_NODE_SURFACE);
+	if (surface_node == NULL) {
+		scene_node_destroy(node);
+		return NULL;
+	}
+
+	struct wlr_xdg_surface *xdg_surface = view->xdg_surface;
+	surface_node->new_popup.notify = node_handle_new_popup;
+	wl_signal_add(&xdg_surface->events.new_popup, &surface_node->new_popup);
+	node_set_surface(surface_node, xdg_surface->surface);
+
+	return node;
+}
+
+/* Called whenever outputs are added, removed or rearranged */
+void scene_update_outputs(struct spider_scene *scene)
+{
+	node_update_position(&scene->root);
+}
+
+void scene_dump_stats(struct spider_scene *scene, FILE *f)
+{
+	fprintf(f, "shm uploads: %u full (%"PRIu64" KiB), %u partial (%"PRIu64" KiB)\n",
+			scene->stats.full_uploads, scene->stats.full_bytes / 1024,
+			scene->stats.partial_uploads, scene->stats.partial_bytes / 1024);
+}
+
+void scene_reset_stats(struct spider_scene *scene)
+{
+	scene->stats.full_uploads = 0;
+	scene->stats.full_bytes = 0;
+	scene->stats.partial_uploads = 0;
+	scene->stats.partial_bytes = 0;
+}
+
+static struct spider_node *node_at(struct spider_node *node,
+		double lx, double ly, double *sx, double *sy)
+{
+	if (!node->enabled) {
+		return NULL;
+	}
+
+	struct spider_node *child;
+	spider_list_for_each_reverse(child, &node->children, link) {
+		if (node->snapshot != NULL) {
+			break;
+		}
+		struct spider_node *found = node_at(child, lx, ly, sx, sy);
+		if (found != NULL) {
+			return found;
+		}
+	}
+
+	if (node->surface != NULL) {
+		double _sx = lx - node->lx;
+		double _sy = ly - node->ly;
+		if (viewport_accepts_input(node->surface, _sx, _sy)) {
+			*sx = _sx;
+			*sy = _sy;
+			return node;
+		}
+	}
+
+	return NULL;
+}
+
+struct spider_node *scene_node_at(struct spider_scene *scene,
+		double lx, double ly, double *sx, double *sy)
+{
+	return node_at(&scene->root, lx, ly, sx, sy);
+}
+
+static void node_for_each_surface(struct spider_node *node,
+		spider_node_iterator_func_t iterator, void *data)
+{
+	if (!node->enabled) {
+		return;
+	}
+
+	if (node->surface != NULL) {
+		iterator(node, data);
+	}
+	if (node->snapshot != NULL) {
+		return;
+	}
+
+	struct spider_node *child;
+	spider_list_for_each(child, &node->children, link) {
+		node_for_each_surface(child, iterator, data);
+	}
+}
+
+void scene_for_each_surface(struct spider_scene *scene,
+		spider_node_iterator_func_t iterator, void *data)
+{
+	node_for_each_surface(&scene->root, iterator, data);
+}
+
+void scene_for_each_layer_surface(struct spider_scene *scene,
+		enum layer_position first, enum layer_position last,
+		spider_node_iterator_func_t iterator, void *data)
+{
+	for (int i = first; i <= last; i++) {
+		node_for_each_surface(&scene->layers[i], iterator, data);
+	}
+}
+
+static void node_for_each_surface_reverse(struct spider_node *node,
+		spider_node_iterator_func_t iterator, void *data)
+{
+	if (!node->enabled) {
+		return;
+	}
+
+	struct spider_node *child;
+	spider_list_for_each_reverse(child, &node->children, link) {
+		if (node->snapshot != NULL) {
+			break;
+		}
+		node_for_each_surface_reverse(child, iterator, data);
+	}
+
+	if (node->surface != NULL) {
+		iterator(node, data);
+	}
+}
+
+void scene_for_each_surface_reverse(struct spider_scene *scene,
+		spider_node_iterator_func_t iterator, void *data)
+{
+	node_for_each_surface_reverse(&scene->root, iterator, data);
+}
+
+void scene_for_each_layer_surface_reverse(struct spider_scene *scene,
+		enum layer_position first, enum layer_position last,
+		spider_node_iterator_func_t iterator, void *data)
+{
+	for (int i = last; i >= (int)first; i--) {
+		node_for_each_surface_reverse(&scene->layers[i], iterator, data);
+	}
+}
+
+static void node_for_each_surface_under_snapshot(struct spider_node *node,
+		bool under_snapshot, spider_node_iterator_func_t iterator, void *data)
+{
+	if (!node->enabled) {
+		return;
+	}
+
+	if (under_snapshot && node->surface != NULL) {
+		iterator(node, data);
+	}
+	under_snapshot = under_snapshot || node->snapshot != NULL;
+
+	struct spider_node *child;
+	spider_list_for_each(child, &node->children, link) {
+		node_for_each_surface_under_snapshot(child, under_snapshot,
+				iterator, data);
+	}
+}
+
+/* Calls iterator for the surfaces the other iterators skip because an
+ * ancestor shows a snapshot, e.g. the subsurfaces and popups of a view
+ * that is being resized. */
+void scene_for_each_surface_under_snapshot(struct spider_scene *scene,
+		spider_node_iterator_func_t iterator, void *data)
+{
+	node_for_each_surface_under_snapshot(&scene->root, false, iterator, data);
+}
+
+struct spider_scene *scene_create(struct spider_compositor *compositor)
+{
+	struct spider_scene *scene = calloc(1, sizeof(struct spider_scene));
+	if (scene == NULL) {
+		spider_err("Allocation Failed\n");
+		return NULL;
+	}
+	scene->compositor = compositor;
+
+	node_init(&scene->root, scene, SPIDER_NODE_ROOT, NULL);
+	for (int i = 0; i < MAX_LAYER_POSITION; i++) {
+		node_init(&scene->layers[i], scene, SPIDER_NODE_LAYER, &scene->root);
+	}
+
+	return scene;
+}
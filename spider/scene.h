@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2019 Minyoung.Go <hedone21@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __SPIDER_SCENE_H__
+#define __SPIDER_SCENE_H__
+
+#include <wayland-server.h>
+#include <pixman.h>
+#include <stdio.h>
+#include <time.h>
+#include <wlr/types/wlr_surface.h>
+#include <wlr/types/wlr_xdg_shell.h>
+#include "spider/layer.h"
+#include "common/util.h"
+
+struct spider_compositor;
+struct spider_output;
+struct spider_view;
+
+enum spider_node_type {
+	SPIDER_NODE_ROOT,
+	SPIDER_NODE_LAYER,
+	SPIDER_NODE_VIEW,
+	SPIDER_NODE_SURFACE,
+	SPIDER_NODE_SUBSURFACE,
+	SPIDER_NODE_POPUP,
+};
+
+/* The scene is a tree that is kept up to date as clients commit and views are
+ * mapped, moved and restacked, so that rendering, hit testing and damage
+ * tracking don't have to rebuild it from the xdg surfaces every frame.
+ *
+ * Children are ordered from bottom to top, and a node is drawn below its
+ * children. Layout coordinates of every node are cached in lx/ly. */
+struct spider_node {
+	enum spider_node_type type;
+	struct spider_scene *scene;
+	struct spider_node *parent;
+	struct spider_list link;
+	struct spider_list children;
+
+	int x, y;
+	int lx, ly;
+	bool enabled;
+
+	struct spider_view *view;
+
+	/* Surface, subsurface and popup nodes */
+	struct wlr_surface *surface;
+	int width, height;
+	/* Bitmask of the indices of the outputs the surface intersects, and the
+	 * one it overlaps the most, which drives its frame callbacks. */
+	uint32_t outputs;
+	struct spider_output *primary_output;
+	/* When the surface was last told to draw its next frame */
+	struct timespec last_frame_done;
+	/* Scratch regions used while an output is being rendered: what is seen
+	 * of the surface, and the part of that it covers with opaque pixels */
+	pixman_region32_t visible;
+	pixman_region32_t visible_opaque;
+	/* Buffer shown at the last commit, to tell texture updates from new
+	 * textures. It isn't locked, which would keep wlroots from updating
+	 * its texture in place, but forgotten once it is destroyed so that a
+	 * new buffer at the same address isn't taken for it. */
+	struct wlr_client_buffer *buffer;
+	struct wl_listener buffer_destroy;
+	/* Copy of the wl_shm buffer for the pixman renderer */
+	pixman_image_t *image;
+	/* Buffer shown instead of the surface's own, stretched to width x
+	 * height, while the view is resized. The children are hidden
+	 * meanwhile. */
+	struct wlr_client_buffer *snapshot;
+
+	struct wl_listener surface_commit;
+	struct wl_listener new_subsurface;
+	struct wl_listener new_popup;
+
+	struct wlr_subsurface *subsurface;
+	struct wl_listener subsurface_map;
+	struct wl_listener subsurface_unmap;
+	struct wl_listener subsurface_destroy;
+
+	struct wlr_xdg_popup *popup;
+	struct wl_listener popup_map;
+	struct wl_listener popup_unmap;
+	struct wl_listener popup_destroy;
+};
+
+struct spider_scene {
+	struct spider_compositor *compositor;
+	struct spider_node root;
+	struct spider_node layers[MAX_LAYER_POSITION];
+
+	/* wl_shm texture uploads, dumped with SIGUSR1 and reset with SIGUSR2.
+	 * Partial ones only wrote the buffer damage into the existing texture. */
+	struct {
+		uint32_t full_uploads;
+		uint64_t full_bytes;
+		uint32_t partial_uploads;
+		uint64_t partial_bytes;
+	} stats;
+};
+
+/* Layers up to this one are drawn from a per-output cache, see
+ * spider_output.layer_cache */
+#define LAYER_CACHE_TOP		LAYER_STATUS_BAR
+
+typedef void (*spider_node_iterator_func_t)(struct spider_node *node, void *data);
+
+struct spider_scene *scene_create(struct spider_compositor *compositor);
+struct spider_node *scene_add_view(struct spider_scene *scene,
+		struct spider_view *view);
+void scene_node_destroy(struct spider_node *node);
+
+void scene_node_set_position(struct spider_node *node, int x, int y);
+void scene_node_set_enabled(struct spider_node *node, bool enabled);
+void scene_node_reparent(struct spider_node *node, struct spider_node *parent);
+void scene_node_raise_to_top(struct spider_node *node);
+void scene_node_lower_to_bottom(struct spider_node *node);
+bool scene_node_is_visible(struct spider_node *node);
+bool scene_node_is_cached(struct spider_node *node);
+bool scene_node_on_output(struct spider_node *node, struct spider_output *output);
+void scene_node_damage_whole(struct spider_node *node);
+struct wlr_texture *scene_node_get_texture(struct spider_node *node);
+bool scene_node_snapshot(struct spider_node *node);
+void scene_node_set_snapshot_size(struct spider_node *node,
+		int width, int height);
+void scene_node_drop_snapshot(struct spider_node *node);
+
+void scene_update_outputs(struct spider_scene *scene);
+void scene_dump_stats(struct spider_scene *scene, FILE *f);
+void scene_reset_stats(struct spider_scene *scene);
+
+struct spider_node *scene_node_at(struct spider_scene *scene,
+		double lx, double ly, double *sx, double *sy);
+void scene_for_each_surface(struct spider_scene *scene,
+		spider_node_iterator_func_t iterator, void *data);
+void scene_for_each_surface_reverse(struct spider_scene *scene,
+		spider_node_iterator_func_t iterator, void *data);
+void scene_for_each_surface_under_snapshot(struct spider_scene *scene,
+		spider_node_iterator_func_t iterator, void *data);
+void scene_for_each_layer_surface(struct spider_scene *scene,
+		enum layer_position first, enum layer_position last,
+		spider_node_iterator_func_t iterator, void *data);
+void scene_for_each_layer_surface_reverse(struct spider_scene *scene,
+		enum layer_position first, enum layer_position last,
+		spider_node_iterator_func_t iterator, void *data);
+
+#endif
@@ -37,5 +37,6 @@ void handle_seat_request_cursor(struct wl_listener *listener, void *data)
 		 * cursor moves between outputs. */
 		wlr_cursor_set_surface(compositor->cursor, event->surface,
 				event->hotspot_x, event->hotspot_y);
+		compositor->cursor_image = NULL;
 	}
 }
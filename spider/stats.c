@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2019 Minyoung.Go <hedone21@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+#include "spider/stats.h"
+
+void histogram_add(struct spider_histogram *histogram, int usec)
+{
+	if (usec < 0) {
+		usec = 0;
+	}
+
+	int bucket = usec / HISTOGRAM_BUCKET_USEC;
+	if (bucket >= HISTOGRAM_BUCKETS) {
+		bucket = HISTOGRAM_BUCKETS - 1;
+	}
+
+	histogram->buckets[bucket]++;
+	histogram->count++;
+	histogram->sum += usec;
+	if (usec > histogram->max) {
+		histogram->max = usec;
+	}
+}
+
+/* Returns the upper bound of the bucket holding the given percentile, which
+ * is accurate to HISTOGRAM_BUCKET_USEC. */
+int histogram_percentile(struct spider_histogram *histogram, int percentile)
+{
+	if (histogram->count == 0) {
+		return 0;
+	}
+
+	uint64_t rank = ((uint64_t)histogram->count * percentile + 99) / 100;
+	uint64_t seen = 0;
+	for (int i = 0; i < HISTOGRAM_BUCKETS - 1; i++) {
+		seen += histogram->buckets[i];
+		if (seen >= rank) {
+			int upper = (i + 1) * HISTOGRAM_BUCKET_USEC;
+			return upper < histogram->max ? upper : histogram->max;
+		}
+	}
+
+	return histogram->max;
+}
+
+void histogram_reset(struct spider_histogram *histogram)
+{
+	memset(histogram, 0, sizeof(*histogram));
+}
+
+void histogram_dump(struct spider_histogram *histogram, const char *name,
+		FILE *f)
+{
+	fprintf(f, "  %-18s n %u avg %.2f p50 %.2f p90 %.2f p99 %.2f max %.2f ms\n",
+			name, histogram->count,
+			histogram->count ? histogram->sum / 1000.0 / histogram->count : 0,
+			histogram_percentile(histogram, 50) / 1000.0,
+			histogram_percentile(histogram, 90) / 1000.0,
+			histogram_percentile(histogram, 99) / 1000.0,
+			histogram->max / 1000.0);
+
+	/* Only the buckets in use, as "upper bound in ms:count" */
+	fprintf(f, "  %-18s", "");
+	for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		if (histogram->buckets[i] == 0) {
+			continue;
+		}
+		if (i == HISTOGRAM_BUCKETS - 1) {
+			fprintf(f, " >%.1f:%u", i * HISTOGRAM_BUCKET_USEC / 1000.0,
+					histogram->buckets[i]);
+		}else {
+			fprintf(f, " %.1f:%u", (i + 1) * HISTOGRAM_BUCKET_USEC / 1000.0,
+					histogram->buckets[i]);
+		}
+	}
+	fprintf(f, "\n");
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2019 Minyoung.Go <hedone21@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __SPIDER_STATS_H__
+#define __SPIDER_STATS_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define HISTOGRAM_BUCKET_USEC	500
+/* The last bucket collects everything from 31.5 ms up */
+#define HISTOGRAM_BUCKETS	64
+
+/* Fixed-size histogram of durations in microseconds. Adding a sample is
+ * cheap enough to do on every frame. */
+struct spider_histogram {
+	uint32_t buckets[HISTOGRAM_BUCKETS];
+	uint32_t count;
+	uint64_t sum;
+	int max;
+};
+
+void histogram_add(struct spider_histogram *histogram, int usec);
+int histogram_percentile(struct spider_histogram *histogram, int percentile);
+void histogram_reset(struct spider_histogram *histogram);
+void histogram_dump(struct spider_histogram *histogram, const char *name,
+		FILE *f);
+
+#endif
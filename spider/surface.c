@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2019 Minyoung.Go <hedone21@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <wlr/render/wlr_texture.h>
+#include "spider/surface.h"
+
+bool surface_is_opaque(struct wlr_surface *wlr_surface)
+{
+	struct wlr_texture *texture = wlr_surface_get_texture(wlr_surface);
+	if (texture == NULL) {
+		return false;
+	}
+
+	/* Buffers without an alpha channel are always opaque. Otherwise trust the
+	 * opaque region the client declared. */
+	if (wlr_texture_is_opaque(texture)) {
+		return true;
+	}
+
+	pixman_box32_t box = {
+		.x1 = 0,
+		.y1 = 0,
+		.x2 = wlr_surface->current.width,
+		.y2 = wlr_surface->current.height,
+	};
+	return pixman_region32_contains_rectangle(&wlr_surface->opaque_region,
+			&box) == PIXMAN_REGION_IN;
+}
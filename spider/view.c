@@ -19,6 +19,8 @@
  */
 
 #include "spider/layer.h"
+#include "spider/output.h"
+#include "spider/scene.h"
 #include "spider/view.h"
 #include "common/log.h"
 #include "common/util.h"
@@ -52,16 +54,14 @@ void maximize_view(struct spider_view *view, bool maximized)
 		struct wlr_output *output = get_output_from_view(view);
 		struct wlr_box *output_box = wlr_output_layout_get_box(view->compositor->output_layout, output);
 
-		view->box.x = output_box->x;
-		view->box.y = output_box->y;
+		move_view(view, output_box->x, output_box->y);
 		view->box.width = output_box->width;
 		view->box.height = output_box->height;
 
 		wlr_xdg_toplevel_set_size(view->xdg_surface, output_box->width, output_box->height);
 	}else if (view->maximized && !maximized) {
 		view->maximized = false;
-		view->box.x = view->saved.x;
-		view->box.y = view->saved.y;
+		move_view(view, view->saved.x, view->saved.y);
 		view->box.width = view->saved.width;
 		view->box.height = view->saved.height;
 
@@ -69,6 +69,180 @@ void maximize_view(struct spider_view *view, bool maximized)
 	}
 }
 
+void move_view(struct spider_view *view, double x, double y)
+{
+	view->box.x = x;
+	view->box.y = y;
+	scene_node_set_position(view->node, view->box.x, view->box.y);
+}
+
+static struct spider_node *view_toplevel_node(struct spider_view *view)
+{
+	struct spider_node *node =
+		wl_container_of(view->node->children.next, node, link);
+	return node;
+}
+
+/* Takes the toplevel's current buffer as the snapshot, stretched so that
+ * its window geometry fills the box */
+static bool view_update_snapshot(struct spider_view *view)
+{
+	struct spider_node *node = view_toplevel_node(view);
+	if (!scene_node_snapshot(node)) {
+		return false;
+	}
+
+	struct wlr_box geo_box;
+	wlr_xdg_surface_get_geometry(view->xdg_surface, &geo_box);
+	view->resize.margin_width = node->surface->current.width - geo_box.width;
+	view->resize.margin_height = node->surface->current.height - geo_box.height;
+	scene_node_set_snapshot_size(node,
+			view->box.width + view->resize.margin_width,
+			view->box.height + view->resize.margin_height);
+	return true;
+}
+
+/* Asks the client for the current size, unless it still has to answer the
+ * last configure. That keeps it from reflowing for every motion event. */
+static void view_resize_configure(struct spider_view *view)
+{
+	if (view->resize.serial != 0 ||
+			(view->box.width == view->resize.width &&
+			 view->box.height == view->resize.height)) {
+		return;
+	}
+
+	view->resize.width = view->box.width;
+	view->resize.height = view->box.height;
+	view->resize.serial = wlr_xdg_toplevel_set_size(view->xdg_surface,
+			view->box.width, view->box.height);
+}
+
+/* The client may have committed another size than it was asked for, e.g. to
+ * honour its minimum size. The view takes that size, and is placed from the
+ * edges that weren't dragged. */
+static void view_apply_committed_size(struct spider_view *view)
+{
+	struct wlr_box geo_box;
+	wlr_xdg_surface_get_geometry(view->xdg_surface, &geo_box);
+
+	double x = view->box.x;
+	double y = view->box.y;
+	if (view->resize.edges & WLR_EDGE_LEFT) {
+		x += view->box.width - geo_box.width;
+	}
+	if (view->resize.edges & WLR_EDGE_TOP) {
+		y += view->box.height - geo_box.height;
+	}
+	view->box.width = geo_box.width;
+	view->box.height = geo_box.height;
+	move_view(view, x, y);
+}
+
+static void view_finish_resize(struct spider_view *view)
+{
+	spider_list_remove(&view->resize.commit.link);
+	view->resize.active = false;
+	view->resize.grabbed = false;
+	view->resize.serial = 0;
+	scene_node_drop_snapshot(view_toplevel_node(view));
+}
+
+static void view_handle_resize_commit(struct wl_listener *listener, void *data)
+{
+	struct spider_view *view =
+		wl_container_of(listener, view, resize.commit);
+
+	/* Serials only grow, but may wrap around */
+	if (view->resize.serial == 0 || (int32_t)(
+				view->xdg_surface->configure_serial -
+				view->resize.serial) < 0) {
+		return;
+	}
+
+	/* This commit has the size of the last configure */
+	view->resize.serial = 0;
+	if (!view->resize.grabbed && view->box.width == view->resize.width &&
+			view->box.height == view->resize.height) {
+		view_apply_committed_size(view);
+		view_finish_resize(view);
+		return;
+	}
+
+	view_update_snapshot(view);
+	view_resize_configure(view);
+}
+
+/* Starts a resize transaction. Without a buffer to show, the view is
+ * resized live instead. */
+void view_begin_resize(struct spider_view *view, uint32_t edges)
+{
+	view->resize.edges = edges;
+	if (view->resize.active) {
+		view->resize.grabbed = true;
+		return;
+	}
+
+	struct wlr_box geo_box;
+	wlr_xdg_surface_get_geometry(view->xdg_surface, &geo_box);
+	view->box.width = geo_box.width;
+	view->box.height = geo_box.height;
+	if (!view_update_snapshot(view)) {
+		return;
+	}
+
+	view->resize.active = true;
+	view->resize.grabbed = true;
+	view->resize.serial = 0;
+	view->resize.width = geo_box.width;
+	view->resize.height = geo_box.height;
+
+	view->resize.commit.notify = view_handle_resize_commit;
+	wl_signal_add(&view->xdg_surface->surface->events.commit,
+			&view->resize.commit);
+}
+
+void view_resize(struct spider_view *view, double x, double y,
+		int width, int height)
+{
+	move_view(view, x, y);
+	view->box.width = width;
+	view->box.height = height;
+
+	if (!view->resize.active) {
+		wlr_xdg_toplevel_set_size(view->xdg_surface, width, height);
+		return;
+	}
+
+	scene_node_set_snapshot_size(view_toplevel_node(view),
+			width + view->resize.margin_width,
+			height + view->resize.margin_height);
+	view_resize_configure(view);
+}
+
+/* The pointer let go. The snapshot stays until the client drew at the
+ * final size. */
+void view_end_resize(struct spider_view *view)
+{
+	if (!view->resize.active) {
+		return;
+	}
+
+	view->resize.grabbed = false;
+	if (view->resize.serial == 0) {
+		view_apply_committed_size(view);
+		view_finish_resize(view);
+	}
+}
+
+/* The view is unmapped or destroyed in the middle of a resize */
+void view_cancel_resize(struct spider_view *view)
+{
+	if (view->resize.active) {
+		view_finish_resize(view);
+	}
+}
+
 static void sort_views(struct spider_list *list)
 {
 
@@ -76,7 +250,10 @@ static void sort_views(struct spider_list *list)
 
 void set_view_layer(struct spider_view *view, enum layer_position layer)
 {
+	struct spider_scene *scene = view->compositor->scene;
+
 	view->layer = layer;
+	scene_node_reparent(view->node, &scene->layers[layer]);
 }
 
 void insert_view(struct spider_view *view)
@@ -85,21 +262,17 @@ void insert_view(struct spider_view *view)
 	struct spider_view *pos;
 
 	spider_list_remove(&view->link);
+	scene_node_raise_to_top(view->node);
 
 	spider_list_for_each(pos, &compositor->views, link) {
-		if (pos->layer > view->layer) {
-			if (pos->link.next != &compositor->views) {
-				continue;
-			}
-
-			spider_list_insert(&pos->link, &view->link);
-
-		}else {
+		if (pos->layer <= view->layer) {
 			spider_list_insert_tail(&pos->link, &view->link);
+			return;
 		}
-
-		break;
 	}
+
+	/* Every other view is in a higher layer */
+	spider_list_insert_tail(&compositor->views, &view->link);
 }
 
 void focus_view(struct spider_view *view, struct wlr_surface *surface)
@@ -141,48 +314,18 @@ void focus_view(struct spider_view *view, struct wlr_surface *surface)
 			keyboard->keycodes, keyboard->num_keycodes, &keyboard->modifiers);
 }
 
-static bool view_at(struct spider_view *view,
-		double lx, double ly, struct wlr_surface **surface,
-		double *sx, double *sy)
-{
-	/*
-	 * XDG toplevels may have nested surfaces, such as popup windows for context
-	 * menus or tooltips. This function tests if any of those are underneath the
-	 * coordinates lx and ly (in output Layout Coordinates). If so, it sets the
-	 * surface pointer to that wlr_surface and the sx and sy coordinates to the
-	 * coordinates relative to that surface's top-left corner.
-	 */
-	double view_sx = lx - view->box.x;
-	double view_sy = ly - view->box.y;
-
-	struct wlr_surface_state *state = &view->xdg_surface->surface->current;
-
-	double _sx, _sy;
-	struct wlr_surface *_surface = NULL;
-	_surface = wlr_xdg_surface_surface_at(
-			view->xdg_surface, view_sx, view_sy, &_sx, &_sy);
-
-	if (_surface != NULL) {
-		*sx = _sx;
-		*sy = _sy;
-		*surface = _surface;
-		return true;
-	}
-
-	return false;
-}
-
 struct spider_view *compositor_view_at(
 		struct spider_compositor *compositor, double lx, double ly,
 		struct wlr_surface **surface, double *sx, double *sy)
 {
-	/* This iterates over all of our surfaces and attempts to find one under the
-	 * cursor. This relies on compositor->views being ordered from top-to-bottom. */
-	struct spider_view *view;
-	spider_list_for_each(view, &compositor->views, link) {
-		if (view_at(view, lx, ly, surface, sx, sy)) {
-			return view;
-		}
+	/* XDG toplevels may have nested surfaces, such as popup windows for
+	 * context menus or tooltips. The scene holds all of them in stacking
+	 * order, so the topmost surface under the cursor is found without
+	 * walking every view. */
+	struct spider_node *node = scene_node_at(compositor->scene, lx, ly, sx, sy);
+	if (node != NULL && node->view != NULL) {
+		*surface = node->surface;
+		return node->view;
 	}
 	
 	spider_verbose("Failed to find compositor view at (%f, %f)\n", ly, ly);
@@ -22,6 +22,8 @@
 #define __SPIDER_VIEW_H__
 
 #include "spider/compositor.h"
+#include "spider/layer.h"
+#include "spider/scene.h"
 #include "common/util.h"
 
 struct spider_view {
@@ -37,6 +39,7 @@ struct spider_view {
 	struct wl_listener request_minimize;
 	struct wl_listener request_fullscreen;
 	struct wlr_box box;
+	struct spider_node *node;
 	int layer;
 	bool mapped;
 
@@ -48,6 +51,24 @@ struct spider_view {
 	bool maximized;
 	bool minimized;
 	bool is_fullscreen;
+
+	/* Interactive resize. While active, the toplevel shows a snapshot
+	 * stretched to box, and the client gets at most one configure in
+	 * flight. The snapshot is refreshed whenever the client committed at
+	 * the configured size, and dropped once it caught up with the final
+	 * one. */
+	struct {
+		bool active;
+		bool grabbed;
+		/* The dragged edges, enum wlr_edges. The others stay put. */
+		uint32_t edges;
+		uint32_t serial;
+		/* Size of the last configure */
+		int width, height;
+		/* Surface size beyond the window geometry, e.g. CSD shadows */
+		int margin_width, margin_height;
+		struct wl_listener commit;
+	} resize;
 };
 
 void maximize_view(struct spider_view *view, bool maximized);
@@ -55,5 +76,13 @@ void focus_view(struct spider_view *view, struct wlr_surface *surface);
 struct spider_view *compositor_view_at(struct spider_compositor *compositor, 
 		double lx, double ly, struct wlr_surface **surface, 
 		double *sx, double *sy);
+void move_view(struct spider_view *view, double x, double y);
+void view_begin_resize(struct spider_view *view, uint32_t edges);
+void view_resize(struct spider_view *view, double x, double y,
+		int width, int height);
+void view_end_resize(struct spider_view *view);
+void view_cancel_resize(struct spider_view *view);
+void set_view_layer(struct spider_view *view, enum layer_position layer);
+void insert_view(struct spider_view *view);
 
 #endif
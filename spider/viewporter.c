@@ -0,0 +1,376 @@
+/*
+ * Copyright (c) 2019 Minyoung.Go <hedone21@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include "spider/viewporter.h"
+#include "common/log.h"
+#include "protocol/viewporter-protocol.h"
+
+static void viewport_handle_surface_destroy(struct wl_listener *listener,
+		void *data);
+
+static struct spider_viewport *viewport_from_surface(struct wlr_surface *surface)
+{
+	struct wl_listener *listener = wl_signal_get(&surface->events.destroy,
+			viewport_handle_surface_destroy);
+	if (listener == NULL) {
+		return NULL;
+	}
+
+	struct spider_viewport *viewport =
+		wl_container_of(listener, viewport, surface_destroy);
+	return viewport;
+}
+
+static void viewport_state_reset(struct spider_viewport_state *state)
+{
+	state->has_src = false;
+	state->has_dst = false;
+}
+
+static void viewport_free(struct spider_viewport *viewport)
+{
+	if (viewport->surface != NULL) {
+		wl_list_remove(&viewport->surface_destroy.link);
+	}
+	free(viewport);
+}
+
+static void viewport_handle_surface_destroy(struct wl_listener *listener,
+		void *data)
+{
+	struct spider_viewport *viewport =
+		wl_container_of(listener, viewport, surface_destroy);
+
+	wl_list_remove(&viewport->surface_destroy.link);
+	viewport->surface = NULL;
+	if (viewport->resource == NULL) {
+		free(viewport);
+	}
+}
+
+static struct spider_viewport *viewport_from_resource(struct wl_resource *resource)
+{
+	struct spider_viewport *viewport = wl_resource_get_user_data(resource);
+	if (viewport->surface == NULL) {
+		wl_resource_post_error(resource, WP_VIEWPORT_ERROR_NO_SURFACE,
+				"wl_surface was destroyed");
+		return NULL;
+	}
+
+	return viewport;
+}
+
+static void viewport_handle_destroy(struct wl_client *client,
+		struct wl_resource *resource)
+{
+	wl_resource_destroy(resource);
+}
+
+static void viewport_handle_set_source(struct wl_client *client,
+		struct wl_resource *resource, wl_fixed_t x, wl_fixed_t y,
+		wl_fixed_t width, wl_fixed_t height)
+{
+	struct spider_viewport *viewport = viewport_from_resource(resource);
+	if (viewport == NULL) {
+		return;
+	}
+
+	struct spider_viewport_state *state = &viewport->pending;
+	if (x == wl_fixed_from_int(-1) && y == wl_fixed_from_int(-1) &&
+			width == wl_fixed_from_int(-1) && height == wl_fixed_from_int(-1)) {
+		state->has_src = false;
+		return;
+	}
+	if (x < 0 || y < 0 || width <= 0 || height <= 0) {
+		wl_resource_post_error(resource, WP_VIEWPORT_ERROR_BAD_VALUE,
+				"invalid source rectangle");
+		return;
+	}
+
+	state->has_src = true;
+	state->src_x = wl_fixed_to_double(x);
+	state->src_y = wl_fixed_to_double(y);
+	state->src_width = wl_fixed_to_double(width);
+	state->src_height = wl_fixed_to_double(height);
+}
+
+static void viewport_handle_set_destination(struct wl_client *client,
+		struct wl_resource *resource, int32_t width, int32_t height)
+{
+	struct spider_viewport *viewport = viewport_from_resource(resource);
+	if (viewport == NULL) {
+		return;
+	}
+
+	struct spider_viewport_state *state = &viewport->pending;
+	if (width == -1 && height == -1) {
+		state->has_dst = false;
+		return;
+	}
+	if (width <= 0 || height <= 0) {
+		wl_resource_post_error(resource, WP_VIEWPORT_ERROR_BAD_VALUE,
+				"invalid destination size");
+		return;
+	}
+
+	state->has_dst = true;
+	state->dst_width = width;
+	state->dst_height = height;
+}
+
+static const struct wp_viewport_interface viewport_impl = {
+	.destroy = viewport_handle_destroy,
+	.set_source = viewport_handle_set_source,
+	.set_destination = viewport_handle_set_destination,
+};
+
+static void viewport_handle_resource_destroy(struct wl_resource *resource)
+{
+	struct spider_viewport *viewport = wl_resource_get_user_data(resource);
+
+	viewport->resource = NULL;
+	if (viewport->surface == NULL) {
+		free(viewport);
+		return;
+	}
+	/* The surface keeps its size until the next commit */
+	viewport_state_reset(&viewport->pending);
+}
+
+static void viewporter_handle_destroy(struct wl_client *client,
+		struct wl_resource *resource)
+{
+	wl_resource_destroy(resource);
+}
+
+static void viewporter_handle_get_viewport(struct wl_client *client,
+		struct wl_resource *resource, uint32_t id,
+		struct wl_resource *surface_resource)
+{
+	struct wlr_surface *surface = wlr_surface_from_resource(surface_resource);
+
+	struct spider_viewport *viewport = viewport_from_surface(surface);
+	if (viewport != NULL && viewport->resource != NULL) {
+		wl_resource_post_error(resource, WP_VIEWPORTER_ERROR_VIEWPORT_EXISTS,
+				"the surface already has a viewport");
+		return;
+	}
+
+	struct wl_resource *viewport_resource = wl_resource_create(client,
+			&wp_viewport_interface, wl_resource_get_version(resource), id);
+	if (viewport_resource == NULL) {
+		wl_client_post_no_memory(client);
+		return;
+	}
+
+	/* A viewport destroyed since the last commit is taken over */
+	if (viewport == NULL) {
+		viewport = calloc(1, sizeof(struct spider_viewport));
+		if (viewport == NULL) {
+			wl_resource_destroy(viewport_resource);
+			wl_client_post_no_memory(client);
+			return;
+		}
+		viewport->surface = surface;
+		viewport->surface_destroy.notify = viewport_handle_surface_destroy;
+		wl_signal_add(&surface->events.destroy, &viewport->surface_destroy);
+	}
+	viewport->resource = viewport_resource;
+
+	wl_resource_set_implementation(viewport_resource, &viewport_impl,
+			viewport, viewport_handle_resource_destroy);
+}
+
+static const struct wp_viewporter_interface viewporter_impl = {
+	.destroy = viewporter_handle_destroy,
+	.get_viewport = viewporter_handle_get_viewport,
+};
+
+static void viewporter_bind(struct wl_client *client, void *data,
+		uint32_t version, uint32_t id)
+{
+	struct wl_resource *resource = wl_resource_create(client,
+			&wp_viewporter_interface, version, id);
+	if (resource == NULL) {
+		wl_client_post_no_memory(client);
+		return;
+	}
+	wl_resource_set_implementation(resource, &viewporter_impl, NULL, NULL);
+}
+
+void create_viewporter(struct wl_display *display)
+{
+	if (wl_global_create(display, &wp_viewporter_interface, 1,
+				NULL, viewporter_bind) == NULL) {
+		spider_err("Failed to create the viewporter\n");
+	}
+}
+
+/* Applies the pending state of the surface's viewport, if it has one. Must be
+ * called once the surface state itself was applied. */
+void viewport_commit(struct wlr_surface *surface)
+{
+	struct spider_viewport *viewport = viewport_from_surface(surface);
+	if (viewport == NULL) {
+		return;
+	}
+
+	if (viewport->resource == NULL) {
+		viewport_free(viewport);
+		return;
+	}
+
+	struct spider_viewport_state *state = &viewport->pending;
+	if (surface->buffer != NULL && state->has_src) {
+		if (!state->has_dst && (state->src_width != floor(state->src_width) ||
+					state->src_height != floor(state->src_height))) {
+			wl_resource_post_error(viewport->resource,
+					WP_VIEWPORT_ERROR_BAD_SIZE,
+					"source size is not integer and no destination is set");
+			return;
+		}
+		if (state->src_x + state->src_width > surface->current.width ||
+				state->src_y + state->src_height > surface->current.height) {
+			wl_resource_post_error(viewport->resource,
+					WP_VIEWPORT_ERROR_OUT_OF_BUFFER,
+					"source rectangle extends outside of the buffer");
+			return;
+		}
+	}
+
+	viewport->current = *state;
+}
+
+/* Returns whether the surface's buffer is cropped or scaled by a viewport */
+bool viewport_is_set(struct wlr_surface *surface)
+{
+	struct spider_viewport *viewport = viewport_from_surface(surface);
+	return viewport != NULL &&
+		(viewport->current.has_src || viewport->current.has_dst);
+}
+
+/* The size of the surface in surface coordinates, i.e. of the destination
+ * of its viewport */
+void viewport_surface_size(struct wlr_surface *surface, int *width, int *height)
+{
+	struct spider_viewport *viewport = viewport_from_surface(surface);
+
+	*width = surface->current.width;
+	*height = surface->current.height;
+	if (viewport == NULL || surface->buffer == NULL) {
+		return;
+	}
+
+	struct spider_viewport_state *state = &viewport->current;
+	if (state->has_dst) {
+		*width = state->dst_width;
+		*height = state->dst_height;
+	}else if (state->has_src) {
+		*width = state->src_width;
+		*height = state->src_height;
+	}
+}
+
+/* Takes the box the surface is drawn into and extends it to where the whole
+ * buffer would go, so that drawing the buffer there, clipped to the original
+ * box, shows just the source rectangle. */
+void viewport_buffer_box(struct wlr_surface *surface, struct wlr_box *box)
+{
+	struct spider_viewport *viewport = viewport_from_surface(surface);
+	if (viewport == NULL || !viewport->current.has_src) {
+		return;
+	}
+
+	struct spider_viewport_state *state = &viewport->current;
+	double scale_x = box->width / state->src_width;
+	double scale_y = box->height / state->src_height;
+
+	box->x -= round(state->src_x * scale_x);
+	box->y -= round(state->src_y * scale_y);
+	box->width = round(surface->current.width * scale_x);
+	box->height = round(surface->current.height * scale_y);
+}
+
+/* Maps damage from buffer-sized surface coordinates, as wlroots reports it,
+ * to the viewport's destination. */
+void viewport_apply_damage(struct wlr_surface *surface, pixman_region32_t *damage)
+{
+	struct spider_viewport *viewport = viewport_from_surface(surface);
+	if (viewport == NULL ||
+			(!viewport->current.has_src && !viewport->current.has_dst)) {
+		return;
+	}
+
+	struct spider_viewport_state *state = &viewport->current;
+	double src_x = 0, src_y = 0;
+	double src_width = surface->current.width;
+	double src_height = surface->current.height;
+	if (state->has_src) {
+		src_x = state->src_x;
+		src_y = state->src_y;
+		src_width = state->src_width;
+		src_height = state->src_height;
+	}
+	if (src_width <= 0 || src_height <= 0) {
+		return;
+	}
+
+	int width, height;
+	viewport_surface_size(surface, &width, &height);
+	double scale_x = width / src_width;
+	double scale_y = height / src_height;
+
+	int nrects;
+	pixman_box32_t *rects = pixman_region32_rectangles(damage, &nrects);
+	pixman_region32_t scaled;
+	pixman_region32_init(&scaled);
+	for (int i = 0; i < nrects; i++) {
+		/* Round outwards, and one more pixel for the filtering that
+		 * scaling does */
+		int x1 = floor((rects[i].x1 - src_x) * scale_x) - 1;
+		int y1 = floor((rects[i].y1 - src_y) * scale_y) - 1;
+		int x2 = ceil((rects[i].x2 - src_x) * scale_x) + 1;
+		int y2 = ceil((rects[i].y2 - src_y) * scale_y) + 1;
+		pixman_region32_union_rect(&scaled, &scaled,
+				x1, y1, x2 - x1, y2 - y1);
+	}
+	pixman_region32_intersect_rect(damage, &scaled, 0, 0, width, height);
+	pixman_region32_fini(&scaled);
+}
+
+bool viewport_accepts_input(struct wlr_surface *surface, double sx, double sy)
+{
+	struct spider_viewport *viewport = viewport_from_surface(surface);
+	if (viewport == NULL) {
+		return wlr_surface_point_accepts_input(surface, sx, sy);
+	}
+
+	/* wlroots clips the input region to the buffer size, which isn't the
+	 * surface size anymore */
+	int width, height;
+	viewport_surface_size(surface, &width, &height);
+	return sx >= 0 && sy >= 0 && sx < width && sy < height &&
+		pixman_region32_contains_point(&surface->current.input,
+				floor(sx), floor(sy), NULL);
+}
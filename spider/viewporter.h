@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2019 Minyoung.Go <hedone21@gmail.com>
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __SPIDER_VIEWPORTER_H__
+#define __SPIDER_VIEWPORTER_H__
+
+#include <wayland-server.h>
+#include <pixman.h>
+#include <stdbool.h>
+#include <wlr/types/wlr_box.h>
+#include <wlr/types/wlr_surface.h>
+
+/* wp_viewporter. The state is double-buffered like the rest of the surface
+ * and is applied by viewport_commit() from the scene's commit handler, so
+ * only surfaces that are part of the scene are cropped and scaled. */
+
+struct spider_viewport_state {
+	bool has_src;
+	double src_x, src_y, src_width, src_height;
+	bool has_dst;
+	int dst_width, dst_height;
+};
+
+struct spider_viewport {
+	/* NULL once the client destroyed it. The state is dropped on the next
+	 * commit then. */
+	struct wl_resource *resource;
+	/* NULL once the surface is gone */
+	struct wlr_surface *surface;
+
+	struct spider_viewport_state pending;
+	struct spider_viewport_state current;
+
+	struct wl_listener surface_destroy;
+};
+
+void create_viewporter(struct wl_display *display);
+void viewport_commit(struct wlr_surface *surface);
+
+bool viewport_is_set(struct wlr_surface *surface);
+void viewport_surface_size(struct wlr_surface *surface, int *width, int *height);
+void viewport_buffer_box(struct wlr_surface *surface, struct wlr_box *box);
+void viewport_apply_damage(struct wlr_surface *surface, pixman_region32_t *damage);
+bool viewport_accepts_input(struct wlr_surface *surface, double sx, double sy);
+
+#endif
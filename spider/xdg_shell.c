@@ -19,6 +19,7 @@
  */
 
 #include "spider/compositor.h"
+#include "spider/scene.h"
 #include "spider/xdg_shell.h"
 #include "spider/view.h"
 #include "common/log.h"
@@ -33,6 +34,7 @@ static void handle_xdg_surface_map(struct wl_listener *listener, void *data)
 	}
 	spider_dbg("new %s is started\n", view->xdg_surface->toplevel->title);
 	view->mapped = true;
+	scene_node_set_enabled(view->node, true);
 	focus_view(view, view->xdg_surface->surface);
 }
 
@@ -40,6 +42,12 @@ static void handle_xdg_surface_unmap(struct wl_listener *listener, void *data)
 {
 	/* Called when the surface is unmapped, and should no longer be shown. */
 	struct spider_view *view = wl_container_of(listener, view, unmap);
+	view_cancel_resize(view);
+	if (view->compositor->grabbed_view == view) {
+		view->compositor->cursor_mode = SPIDER_CURSOR_PASSTHROUGH;
+		view->compositor->grabbed_view = NULL;
+	}
+	scene_node_set_enabled(view->node, false);
 	view->mapped = false;
 }
 
@@ -47,6 +55,8 @@ static void handle_xdg_surface_destroy(struct wl_listener *listener, void *data)
 {
 	/* Called when the surface is destroyed and should never be shown again. */
 	struct spider_view *view = wl_container_of(listener, view, destroy);
+	view_cancel_resize(view);
+	scene_node_destroy(view->node);
 	spider_list_remove(&view->link);
 	free(view);
 }
@@ -77,6 +87,9 @@ static void begin_interactive(struct spider_view *view,	enum spider_cursor_mode
 	compositor->grab_width = geo_box.width;
 	compositor->grab_height = geo_box.height;
 	compositor->resize_edges = edges;
+	if (mode == SPIDER_CURSOR_RESIZE) {
+		view_begin_resize(view, edges);
+	}
 }
 
 static void handle_xdg_toplevel_request_move(struct wl_listener *listener, void *data)
@@ -143,6 +156,11 @@ void handle_new_xdg_surface(struct wl_listener *listener, void *data)
 	view->compositor = compositor;
 	view->xdg_surface = xdg_surface;
 	view->layer = LAYER_TOP;
+	view->node = scene_add_view(compositor->scene, view);
+	if (view->node == NULL) {
+		free(view);
+		return;
+	}
 
 	/* Listen to the various events it can emit */
 	view->map.notify = handle_xdg_surface_map;